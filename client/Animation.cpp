@@ -0,0 +1,1300 @@
+/*
+ * Animation.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#include "Animation.h"
+
+/**
+ * Constructor
+ */
+Animation::Animation()
+{
+	controller = 0;
+	cmd = 0;
+	leds = 0;
+	running = false;
+	started = false;
+	count = 0;
+	endTime = 0;
+}
+
+/**
+ * Attaches the animation to the LED controller and the command
+ * holding the animation parameters.
+ *
+ */
+void Animation::attach(NeopixelWrapper* controller, Command* cmd)
+{
+	this->controller = controller;
+	this->cmd = cmd;
+	this->leds = controller->getLeds();
+}
+
+/**
+ * Returns true while the animation has frames left to render
+ */
+uint8_t Animation::isRunning()
+{
+	return running;
+}
+
+/**
+ * Marks the animation as complete
+ */
+void Animation::stop()
+{
+	running = false;
+}
+
+/**
+ * Resets the common animation state; called by begin()
+ */
+void Animation::start(uint32_t now)
+{
+	running = true;
+	started = false;
+	count = 0;
+	endTime = now + cmd->getDuration();
+}
+
+/**
+ * Returns true if the repeat count or the duration has been reached
+ */
+uint8_t Animation::isComplete(uint32_t now)
+{
+	if( cmd->getRepeat() > 0 && count >= cmd->getRepeat() )
+	{
+		return true;
+	}
+	return isExpired(now);
+}
+
+/**
+ * Returns true if the duration has been reached; safe across millis() rollover
+ */
+uint8_t Animation::isExpired(uint32_t now)
+{
+	return ( cmd->getDuration() > 0 && (int32_t)(now - endTime) > 0 );
+}
+
+/**
+ * Counts a completed cycle; returns true if the animation is complete
+ */
+uint8_t Animation::nextCycle(uint32_t now)
+{
+	count += 1;
+	return isComplete(now);
+}
+
+/**
+ * Returns the on color, or a random color if the on color is RAINBOW
+ */
+CRGB Animation::getOnColor()
+{
+	if( cmd->getOnColor() == (CRGB)RAINBOW )
+	{
+		return CHSV(random8(0, 255), 255, 255);
+	}
+	return cmd->getOnColor();
+}
+
+/**
+ * Turns on LEDs one at time in sequence.  LEFT = 0->n; RIGHT = n -> 0
+ *
+ * @direction - left (up) or right (down)
+ * @onColor - color to fill LEDs with
+ * @offColor - color to fill LEDs with
+ * @onTime - time to keep LED on
+ * @offTime - time to keep LED off
+ * @clearAfter - turn LED off after waiting
+ * @clearEnd - clear after complete
+ */
+void WipeAnimation::begin(uint32_t now)
+{
+	start(now);
+	controller->resetIntensity();
+
+	// clear LEDs
+	controller->fill(cmd->getOffColor(), false);
+
+	phase = PHASE_ON;
+	if( cmd->getDirection() == LEFT )
+	{
+		index = 0;
+	}
+	else if( cmd->getDirection() == RIGHT )
+	{
+		index = controller->size()-1;
+	}
+	else
+	{
+		stop();
+	}
+}
+
+uint32_t WipeAnimation::step(uint32_t now)
+{
+	int8_t increment = (cmd->getDirection() == LEFT) ? 1 : -1;
+
+	if( phase == PHASE_OFF )
+	{
+		controller->setPixel(index, cmd->getOffColor(), false);
+		index += increment;
+		phase = PHASE_ON;
+		return cmd->getOffTime();
+	}
+
+	// Check if we wiped the whole strip
+	if( index < 0 || index >= controller->size() )
+	{
+		if( nextCycle(now) )
+		{
+			if( cmd->getClearEnd() )
+			{
+				controller->fill(cmd->getOffColor(), false);
+			}
+			stop();
+			return 0;
+		}
+		index = (cmd->getDirection() == LEFT) ? 0 : controller->size()-1;
+	}
+
+	controller->setPixel(index, cmd->getOnColor(), false);
+	if( cmd->getClearAfter() )
+	{
+		phase = PHASE_OFF;
+	}
+	else
+	{
+		index += increment;
+	}
+
+	return cmd->getOnTime();
+}
+
+/**
+ * Rotates a pattern across the strip; onTime determines pause between rotation
+ *
+ * NOTE: Starts at 0, and repeats every 8 pixels through end of strip
+ */
+void RotatePatternAnimation::begin(uint32_t now)
+{
+	start(now);
+	controller->resetIntensity();
+	pattern = cmd->getPattern();
+}
+
+uint32_t RotatePatternAnimation::step(uint32_t now)
+{
+	uint8_t i;
+
+	if( started )
+	{
+		if (cmd->getDirection() == LEFT)
+		{
+			i = (pattern & 0x80) ? 0x01 : 0x00;
+			pattern = pattern << 1;
+			pattern = pattern | i;
+		}
+		else if (cmd->getDirection() == RIGHT)
+		{
+			i = (pattern & 0x01) ? 0x80 : 0x00;
+			pattern = pattern >> 1;
+			pattern = pattern | i;
+		}
+
+		if( nextCycle(now) )
+		{
+			stop();
+			return 0;
+		}
+	}
+	started = true;
+
+	controller->setPattern(0, controller->size(), pattern, 8, cmd->getOnColor(), cmd->getOffColor(), false);
+
+	return cmd->getOnTime();
+}
+
+/**
+ * Turns on LEDs one at time in sequence.  LEFT = 0->n; RIGHT = n -> 0
+ *
+ * NOTE: starts with pattern "off" the screen and scrolls "on" the screen,
+ *       then "off" the screen again
+ *
+ * @pattern - the pattern to wipe
+ * @direction - left (up) or right (down)
+ * @onColor - color to fill LEDs with
+ * @offColor - color to fill LEDs with
+ * @onTime - time to keep LED on
+ * @offTime - time to keep LED off
+ * @clearAfter - turn LED off after waiting
+ * @clearEnd - clear after complete
+ */
+void ScrollPatternAnimation::begin(uint32_t now)
+{
+	start(now);
+	controller->resetIntensity();
+
+	patternLength = cmd->getPatternLength();
+	if( patternLength == 0 || patternLength > 8 )
+	{
+		patternLength = 8;
+	}
+
+	// Initialize the pixel buffer
+	for(uint8_t i=0; i<patternLength; i++)
+	{
+		// rotates pattern and tests for "on"
+		if ((cmd->getPattern() >> i) & 0x01)
+		{
+			pixels[i] = cmd->getOnColor();
+		}
+		else
+		{
+			pixels[i] = cmd->getOffColor();
+		}
+	}
+
+	// clear LEDs
+	controller->fill(cmd->getOffColor(), false);
+	index = 0;
+}
+
+uint32_t ScrollPatternAnimation::step(uint32_t now)
+{
+	int16_t size = controller->size();
+	int16_t curIndex;
+	uint8_t bitsToCopy;
+	uint8_t start;
+
+	if( started && cmd->getClearAfter() )
+	{
+		controller->fill(cmd->getOffColor(), false);
+	}
+
+	// Check if the pattern scrolled completely off the strip
+	if( index >= (size+patternLength-1) )
+	{
+		if( nextCycle(now) )
+		{
+			if( cmd->getClearEnd() )
+			{
+				controller->fill(cmd->getOffColor(), false);
+			}
+			stop();
+			return 0;
+		}
+		index = 0;
+	}
+	started = true;
+
+	// Set start location
+	if( cmd->getDirection() == LEFT )
+	{
+		if( (index >= (patternLength-1)) && (index <= (size - 1)) )
+		{
+			// copy all pixels to leds
+			curIndex = index;
+			for(uint8_t i=0; i<patternLength; i++)
+			{
+				controller->setPixel(curIndex--, pixels[i], false);
+			}
+		}
+		else if( index <= (patternLength-1) )
+		{
+			curIndex = index;
+			bitsToCopy = index+1;
+			for(uint8_t i=0; i< bitsToCopy; i++)
+			{
+				controller->setPixel(curIndex--, pixels[i], false);
+			}
+		}
+		else if( index > (size-1) )
+		{
+			curIndex = size-1;
+			bitsToCopy = (patternLength-1) - (index-size);
+			start = (patternLength-bitsToCopy);
+			for(uint8_t i=start; i<patternLength; i++)
+			{
+				controller->setPixel(curIndex--, pixels[i], false);
+			}
+		}
+	} // end if LEFT
+	else if( cmd->getDirection() == RIGHT )
+	{
+		if( (index >= (patternLength-1)) && (index <= (size - 1)) )
+		{
+			// copy all pixels to leds
+			curIndex = size - index - 1;
+			for(uint8_t i=0; i<patternLength; i++)
+			{
+				controller->setPixel(curIndex++, pixels[i], false);
+			}
+		}
+		else if( index < (patternLength-1) )
+		{
+			curIndex = size - index - 1;
+			bitsToCopy = size - curIndex;
+			for(uint8_t i=0; i< bitsToCopy; i++)
+			{
+				controller->setPixel(curIndex++, pixels[i], false);
+			}
+		}
+		else if( index > (size-1) )
+		{
+			curIndex = 0;
+			bitsToCopy = (patternLength-1) - (index-size);
+			start = (patternLength-bitsToCopy);
+			for(uint8_t i=start; i<patternLength; i++)
+			{
+				controller->setPixel(curIndex++, pixels[i], false);
+			}
+		}
+	} //end if RIGHT
+
+	index += 1;
+
+	return cmd->getOnTime();
+}
+
+/**
+ * Bounces the specified pattern the specified direction.
+ *
+ * NOTE: Pattern does not double flash at the ends.
+ *
+ */
+void BounceAnimation::begin(uint32_t now)
+{
+	int16_t size = controller->size();
+
+	// custom bounce with 0-7, n-(n-7)
+	start(now);
+	controller->resetIntensity();
+
+	patternLength = cmd->getPatternLength();
+	first = true;
+	sweep = 0;
+	phase = PHASE_ON;
+
+	if (cmd->getDirection() == LEFT)
+	{
+		lstart = 0;
+		lend = size - patternLength;
+
+		rstart = size - patternLength - 1;
+		rend = 0;
+	}
+	else if (cmd->getDirection() == RIGHT)
+	{
+		rstart = size - patternLength;
+		rend = 0;
+
+		lstart = 1;
+		lend = size - patternLength;
+	}
+	else
+	{
+		stop();
+		return;
+	}
+
+	// Fill with off color
+	controller->fill(cmd->getOffColor(), false);
+
+	index = sweepStart(sweep);
+}
+
+uint32_t BounceAnimation::step(uint32_t now)
+{
+	int8_t increment;
+
+	for(;;)
+	{
+		increment = sweepDirection(sweep);
+
+		switch( phase )
+		{
+		case PHASE_OFF:
+			controller->fill(cmd->getOffColor(), false);
+			index += increment;
+			phase = PHASE_ON;
+			return cmd->getOffTime();
+
+		case PHASE_BOUNCE:
+			phase = PHASE_ON;
+			if( nextSweep(now) )
+			{
+				return 0;
+			}
+			if( sweep == 0 )
+			{
+				return 0; // yield at the end of each cycle
+			}
+			break;
+
+		case PHASE_ON:
+		default:
+			// Check if we hit the end of this sweep
+			if( (increment > 0 && index > sweepEnd(sweep)) || (increment < 0 && index < sweepEnd(sweep)) )
+			{
+				if( cmd->getClearEnd() )
+				{
+					controller->fill(cmd->getOffColor(), false);
+					phase = PHASE_BOUNCE;
+					return cmd->getBounceTime();
+				}
+				if( nextSweep(now) )
+				{
+					return 0;
+				}
+				if( sweep == 0 )
+				{
+					return 0; // yield at the end of each cycle
+				}
+				break;
+			}
+
+			controller->setPattern(index, patternLength, cmd->getPattern(), patternLength, cmd->getOnColor(), cmd->getOffColor(), false);
+			if( cmd->getClearAfter() )
+			{
+				phase = PHASE_OFF;
+			}
+			else
+			{
+				index += increment;
+			}
+			return cmd->getOnTime();
+		}
+	}
+
+	return 0;
+
+} // end step
+
+/**
+ * Moves to the next sweep; returns true if the animation is complete
+ */
+uint8_t BounceAnimation::nextSweep(uint32_t now)
+{
+	int16_t size = controller->size();
+
+	sweep += 1;
+	if( sweep == 2 )
+	{
+		sweep = 0;
+
+		// After the first pass, don't double flash the ends
+		if( first )
+		{
+			if( cmd->getDirection() == LEFT )
+			{
+				lstart = 1;
+				lend = size - patternLength - 1;
+				rstart = size - patternLength;
+				rend = 0;
+			}
+			else
+			{
+				rstart = size - patternLength -1;
+				rend = 0;
+				lstart = 1;
+				lend = size - patternLength;
+			}
+			first = false;
+		}
+
+		if( nextCycle(now) )
+		{
+			stop();
+			return true;
+		}
+	}
+
+	index = sweepStart(sweep);
+
+	return false;
+}
+
+/**
+ * LEFT bounces sweep up first then down; RIGHT sweeps down first then up
+ */
+int8_t BounceAnimation::sweepDirection(uint8_t sweep)
+{
+	if( (cmd->getDirection() == LEFT) == (sweep == 0) )
+	{
+		return 1;
+	}
+	return -1;
+}
+
+int16_t BounceAnimation::sweepStart(uint8_t sweep)
+{
+	return (sweepDirection(sweep) > 0) ? lstart : rstart;
+}
+
+int16_t BounceAnimation::sweepEnd(uint8_t sweep)
+{
+	return (sweepDirection(sweep) > 0) ? lend : rend;
+}
+
+/**
+ * Starts in the middle and works out; or starts in the end and works in
+ */
+void MiddleAnimation::begin(uint32_t now)
+{
+	start(now);
+	controller->resetIntensity();
+	controller->fill(cmd->getOffColor(), false);
+
+	index = 0;
+	phase = PHASE_ON;
+	if( cmd->getDirection() != IN && cmd->getDirection() != OUT )
+	{
+		stop();
+	}
+}
+
+uint32_t MiddleAnimation::step(uint32_t now)
+{
+	uint16_t halfNumPixels = controller->size()/2;
+	uint16_t limit = (cmd->getDirection() == IN) ? halfNumPixels : halfNumPixels+1;
+
+	if( phase == PHASE_OFF )
+	{
+		setPixels( cmd->getOffColor() );
+		index += 1;
+		phase = PHASE_ON;
+		return cmd->getOffTime();
+	}
+
+	if( index >= limit )
+	{
+		if( cmd->getClearEnd() )
+		{
+			controller->fill(cmd->getOffColor(), false);
+		}
+		if( nextCycle(now) )
+		{
+			stop();
+			return 0;
+		}
+		index = 0;
+	}
+
+	setPixels( cmd->getOnColor() );
+	if( cmd->getClearAfter() == true )
+	{
+		phase = PHASE_OFF;
+	}
+	else
+	{
+		index += 1;
+	}
+
+	return cmd->getOnTime();
+}
+
+/**
+ * Sets the pair of pixels for the current index
+ */
+void MiddleAnimation::setPixels(CRGB color)
+{
+	int16_t numPixels = controller->size();
+	int16_t halfNumPixels = numPixels/2;
+
+	if( cmd->getDirection() == IN )
+	{
+		controller->setPixel(index, color, false);
+		controller->setPixel((numPixels-1)-index, color, false);
+	}
+	else
+	{
+		controller->setPixel(halfNumPixels-index, color, false);
+		controller->setPixel(halfNumPixels+index, color, false);
+	}
+}
+
+/**
+ * Flashes random LED with specified color
+ */
+void RandomFlashAnimation::begin(uint32_t now)
+{
+	start(now);
+	controller->resetIntensity();
+	controller->fill(cmd->getOffColor(), false);
+
+	number = cmd->getNumber();
+	if( number == 0)
+	{
+		number = 1;
+	}
+	if( number > controller->size() )
+	{
+		number = controller->size();
+	}
+	phase = PHASE_ON;
+}
+
+uint32_t RandomFlashAnimation::step(uint32_t now)
+{
+	uint16_t i, j;
+
+	if( phase == PHASE_OFF )
+	{
+		controller->fill(cmd->getOffColor(), false);
+		phase = PHASE_ON;
+		return cmd->getOffTime();
+	}
+
+	if( started && nextCycle(now) )
+	{
+		controller->fill(cmd->getOffColor(), false);
+		stop();
+		return 0;
+	}
+	started = true;
+
+	for(j=0; j<number; j++)
+	{
+		do
+		{
+			i = random(controller->size());
+
+		} while( controller->getPixel(i) != cmd->getOffColor() );
+
+		controller->setPixel(i, getOnColor(), false);
+	}
+	phase = PHASE_OFF;
+
+	return cmd->getOnTime();
+
+} // randomFlash
+
+/**
+ * Fades LEDs up or down with the specified time increment
+ */
+void FadeAnimation::begin(uint32_t now)
+{
+	start(now);
+	level = 0;
+
+	if( cmd->getDirection() == DOWN )
+	{
+		controller->setIntensity(255);
+	}
+	else if( cmd->getDirection() == UP )
+	{
+		controller->setIntensity(0);
+	}
+}
+
+uint32_t FadeAnimation::step(uint32_t now)
+{
+	if( started )
+	{
+		level = level + cmd->getFadeIncrement();
+		if( level > 255 )
+		{
+			level = 255;
+		}
+
+		if( cmd->getDirection() == DOWN )
+		{
+			controller->setIntensity(255-level);
+		}
+		else if( cmd->getDirection() == UP)
+		{
+			controller->setIntensity(level);
+		}
+
+		if( level >= 255 )
+		{
+			stop();
+		}
+	}
+	started = true;
+
+	fill_solid(leds, controller->size(), cmd->getOnColor());
+
+	return cmd->getFadeTime();
+}
+
+/**
+ * Flashes LEDs
+ */
+void StrobeAnimation::begin(uint32_t now)
+{
+	start(now);
+	controller->resetIntensity();
+	phase = PHASE_ON;
+}
+
+uint32_t StrobeAnimation::step(uint32_t now)
+{
+	if( phase == PHASE_OFF )
+	{
+		controller->fill(cmd->getOffColor(), false);
+		phase = PHASE_ON;
+		return cmd->getOffTime();
+	}
+
+	if( started && nextCycle(now) )
+	{
+		stop();
+		return 0;
+	}
+	started = true;
+
+	controller->fill(cmd->getOnColor(), false);
+	phase = PHASE_OFF;
+
+	return cmd->getOnTime();
+}
+
+/**
+ * Creates lightning effort; each cycle flashes one more time than the last
+ */
+void LightningAnimation::begin(uint32_t now)
+{
+	start(now);
+	controller->resetIntensity();
+	big = false;
+	flash = 0;
+	large = 0;
+	phase = PHASE_ON;
+}
+
+uint32_t LightningAnimation::step(uint32_t now)
+{
+	if( phase == PHASE_OFF )
+	{
+		controller->fill(cmd->getOffColor(), false);
+		phase = PHASE_ON;
+		flash += 1;
+		if( large > 40 && big == false )
+		{
+			return random(200, 500);
+		}
+		return random(30, 70);
+	}
+
+	// Check if we completed the flashes for this cycle
+	if( flash >= count )
+	{
+		flash = 0;
+		if( nextCycle(now) )
+		{
+			stop();
+		}
+		return 0;
+	}
+
+	large = random(0,100);
+	controller->fill(cmd->getOnColor(), false);
+	phase = PHASE_OFF;
+	if( large > 40 && big == false)
+	{
+		big = true;
+		return random(100, 350);
+	}
+
+	return random(20, 50);
+}
+
+/**
+ * Stacks LEDs based on direction
+ *
+ */
+void StackAnimation::begin(uint32_t now)
+{
+	start(now);
+	controller->resetIntensity();
+	controller->fill(cmd->getOffColor(), false);
+
+	if( controller->size() == 0 || (cmd->getDirection() != DOWN && cmd->getDirection() != UP) )
+	{
+		stop();
+		return;
+	}
+	reset();
+}
+
+uint32_t StackAnimation::step(uint32_t now)
+{
+	int8_t increment = (cmd->getDirection() == DOWN) ? 1 : -1;
+
+	for(;;)
+	{
+		// Turn off the previous falling pixel
+		if( previous >= 0 )
+		{
+			controller->setPixel(previous, cmd->getOffColor(), false);
+			previous = -1;
+		}
+
+		// Check if the falling pixel landed on the stack
+		if( pixel == index )
+		{
+			controller->setPixel(index, getOnColor(), false);
+			placed += 1;
+			if( placed >= controller->size() )
+			{
+				if( cmd->getClearEnd() == true )
+				{
+					controller->fill(cmd->getOffColor(), false);
+				}
+				if( nextCycle(now) )
+				{
+					stop();
+					return 0;
+				}
+				reset();
+				return 0; // yield at the end of each cycle
+			}
+			index += increment;
+			pixel = (cmd->getDirection() == DOWN) ? controller->size()-1 : 0;
+			continue;
+		}
+
+		controller->setPixel(pixel, getOnColor(), false);
+		previous = pixel;
+		pixel -= increment;
+
+		return cmd->getOnTime();
+	}
+
+	return 0;
+
+} // end stack
+
+/**
+ * Starts a new stack
+ */
+void StackAnimation::reset()
+{
+	placed = 0;
+	previous = -1;
+	if( cmd->getDirection() == DOWN )
+	{
+		index = 0;
+		pixel = controller->size()-1;
+	}
+	else
+	{
+		index = controller->size()-1;
+		pixel = 0;
+	}
+}
+
+/**
+ * Randomly fills string with specified color
+ *
+ */
+void FillRandomAnimation::begin(uint32_t now)
+{
+	start(now);
+	controller->resetIntensity();
+	controller->fill(cmd->getOffColor(), false);
+
+	total = controller->size();
+	index = 0;
+	flag = false;
+	phase = PHASE_ON;
+}
+
+uint32_t FillRandomAnimation::step(uint32_t now)
+{
+	CRGB color;
+
+	if( phase == PHASE_OFF )
+	{
+		controller->setPixel(index, cmd->getOffColor(), false);
+		phase = PHASE_ON;
+		return cmd->getOffTime();
+	}
+
+	// Check if all pixels were filled
+	if( total == 0 )
+	{
+		flag = true;
+		if( cmd->getClearEnd() )
+		{
+			controller->fill(cmd->getOffColor(), false);
+			flag = false;
+		}
+		if( nextCycle(now) )
+		{
+			stop();
+			return 0;
+		}
+		total = controller->size();
+	}
+
+	color = getOnColor();
+	do
+	{
+		index = random16(0, controller->size());
+
+	} while( controller->getPixel(index) != cmd->getOffColor() && flag == false );
+
+	controller->setPixel(index, color, false);
+	total--;
+	if( cmd->getClearAfter() )
+	{
+		phase = PHASE_OFF;
+	}
+
+	return cmd->getOnTime();
+
+} // end randomFill
+
+/**
+ * Fills strip with rainbow pattern
+ *
+ * @glitter if true, randomly pops white into rainbow pattern
+ */
+void RainbowAnimation::begin(uint32_t now)
+{
+	start(now);
+	controller->resetIntensity();
+	controller->fill(BLACK, false);
+	hue = 0;
+	hueTime = 0;
+
+	// Glitter goes on the overlay so the rainbow is only drawn when the hue moves
+	glitter = 0;
+	glitterIndex = -1;
+	if( cmd->getProbability() > 0 && cmd->getLayer() == LAYER_BASE
+			&& !controller->isLayerEnabled(LAYER_OVERLAY)
+			&& controller->enableLayer(LAYER_OVERLAY, BLEND_ADD, 255) )
+	{
+		glitter = controller->getLayer(LAYER_OVERLAY);
+	}
+}
+
+uint32_t RainbowAnimation::step(uint32_t now)
+{
+	uint8_t render = !started;
+
+	if( started )
+	{
+		hueTime +=1;
+		if( hueTime == cmd->getHueUpdateTime() )
+		{
+			hueTime = 0;
+			hue += 1;
+			render = true;
+		}
+
+		if( isExpired(now) )
+		{
+			stop();
+			return 0;
+		}
+	}
+	started = true;
+
+	// Inline glitter has to be erased by drawing the rainbow again
+	if( render || (glitter == 0 && cmd->getProbability() > 0) )
+	{
+		// FastLED's built-in rainbow generator
+		fill_rainbow(leds, controller->size(), hue, 7);
+		controller->markDirty(cmd->getLayer());
+	}
+
+	if( glitter != 0 )
+	{
+		if( glitterIndex >= 0 )
+		{
+			glitter[glitterIndex] = BLACK;
+			glitterIndex = -1;
+			controller->markDirty(LAYER_OVERLAY);
+		}
+		if (random8() < cmd->getProbability())
+		{
+			glitterIndex = random16(controller->size());
+			glitter[glitterIndex] = cmd->getOnColor();
+			controller->markDirty(LAYER_OVERLAY);
+		}
+	}
+	else if (cmd->getProbability() > 0)
+	{
+		if (random8() < cmd->getProbability())
+		{
+			leds[random16(controller->size())] += cmd->getOnColor();
+		}
+	}
+
+	return cmd->getOnTime();
+
+} // end rainbow
+
+/**
+ * Releases the glitter overlay
+ */
+void RainbowAnimation::finish()
+{
+	if( glitter != 0 )
+	{
+		controller->disableLayer(LAYER_OVERLAY);
+		glitter = 0;
+	}
+}
+
+/**
+ * This function draws rainbows with an ever-changing,widely-varying set of parameters.
+ * https://gist.github.com/kriegsman/964de772d64c502760e5
+ *
+ */
+RainbowFadeAnimation::RainbowFadeAnimation()
+{
+	sPseudotime = 0;
+	sLastMillis = 0;
+	sHue16 = 0;
+}
+
+void RainbowFadeAnimation::begin(uint32_t now)
+{
+	//TODO: Figure out to better control timing with FPS or hue update time
+
+	start(now);
+	controller->resetIntensity();
+	controller->fill(BLACK, false);
+}
+
+uint32_t RainbowFadeAnimation::step(uint32_t now)
+{
+	if( started && isExpired(now) )
+	{
+		stop();
+		return 0;
+	}
+	started = true;
+
+	uint8_t sat8 = beatsin88(87, 220, 250);
+	uint8_t brightdepth = beatsin88(341, 96, 224);
+	uint16_t brightnessthetainc16 = beatsin88(203, (25 * 256), (40 * 256));
+	uint8_t msmultiplier = beatsin88(147, 23, 60);
+
+	uint16_t hue16 = sHue16; //gHue * 256;
+	uint16_t hueinc16 = beatsin88(113, 1, 3000);
+
+	uint16_t ms = now;
+	uint16_t deltams = ms - sLastMillis;
+	sLastMillis = ms;
+	sPseudotime += deltams * msmultiplier;
+	sHue16 += deltams * beatsin88(400, 5, 9);
+	uint16_t brightnesstheta16 = sPseudotime;
+
+	for (uint16_t i = 0; i < (uint16_t) controller->size(); i++)
+	{
+		hue16 += hueinc16;
+		uint8_t hue8 = hue16 / 256;
+
+		brightnesstheta16 += brightnessthetainc16;
+		uint16_t b16 = sin16(brightnesstheta16) + 32768;
+
+		uint16_t bri16 = (uint32_t) ((uint32_t) b16 * (uint32_t) b16) / 65536;
+		uint8_t bri8 = (uint32_t) (((uint32_t) bri16) * brightdepth) / 65536;
+		bri8 += (255 - brightdepth);
+
+		CRGB newcolor = CHSV(hue8, sat8, bri8);
+
+		uint16_t pixelnumber = i;
+		pixelnumber = (controller->size() - 1) - pixelnumber;
+
+		nblend(leds[pixelnumber], newcolor, 64);
+	}
+
+	return cmd->getOnTime();
+
+} // end rainbow fade
+
+/**
+ * Creates random speckles of the specified color.
+ *
+ * 5-10 LEDs makes a nice effect
+ *
+ */
+void ConfettiAnimation::begin(uint32_t now)
+{
+	start(now);
+	controller->resetIntensity(); // reset intensity to full
+	controller->fill(BLACK, false); // clear any previous colors
+	hue = 0;
+	hueTime = 0;
+}
+
+uint32_t ConfettiAnimation::step(uint32_t now)
+{
+	if( started )
+	{
+		hueTime += 1;
+		if( isExpired(now) )
+		{
+			stop();
+			return 0;
+		}
+	}
+	started = true;
+
+	// random colored speckles that blink in and fade smoothly
+	fadeToBlackBy(leds, controller->size(), cmd->getFadeBy());
+	int pos = random16(controller->size());
+	if (cmd->getOnColor() == (CRGB)RAINBOW)
+	{
+		leds[pos] += CHSV(hue + random8(64), 200, 255);
+		// do some periodic updates
+		if( hueTime == cmd->getHueUpdateTime() )
+		{
+			hueTime = 0;
+			hue += 1;
+		}
+	}
+	else
+	{
+		leds[pos] += cmd->getOnColor();
+	}
+
+	return cmd->getOnTime();
+
+} // end confetti
+
+/**
+ * Creates "cylon" pattern - bright led followed up dimming LEDs back and forth
+ *
+ */
+void CylonAnimation::begin(uint32_t now)
+{
+	start(now);
+	controller->resetIntensity();
+	controller->fill( BLACK, false);
+	hue = 0;
+	hueTime = 0;
+	flag = false; // flag to increment counter
+	position = 0;
+}
+
+uint32_t CylonAnimation::step(uint32_t now)
+{
+	if( started )
+	{
+		hueTime += 1;
+
+		if( position == 0 && flag == false)
+		{
+			count += 1;
+			flag = true; // set flag
+		}
+		if( flag == true && position != 0 )
+		{
+			flag = false; // wait for beats to go past 0
+		}
+		if( isComplete(now) )
+		{
+			stop();
+			return 0;
+		}
+	}
+	started = true;
+
+	fadeToBlackBy(leds, controller->size(), 20);
+	position = beatsin16(cmd->getFramesPerSecond(), 0, controller->size());
+	if (cmd->getOnColor() == (CRGB)RAINBOW)
+	{
+		leds[position] += CHSV(hue, 255, 192);
+		if( hueTime == cmd->getHueUpdateTime())
+		{
+			hueTime = 0;
+			hue +=1;
+		}
+	}
+	else
+	{
+		leds[position] += cmd->getOnColor();
+	}
+
+	return cmd->getFadeTime();
+
+} // end cylon
+
+/**
+ * No clue how to explain this one...
+ *
+ */
+void BpmAnimation::begin(uint32_t now)
+{
+	start(now);
+	controller->resetIntensity();
+	controller->fill( BLACK, false);
+	hue = 0;
+	hueTime = 0;
+}
+
+uint32_t BpmAnimation::step(uint32_t now)
+{
+	if( started )
+	{
+		hueTime += 1;
+		if( isExpired(now) )
+		{
+			stop();
+			return 0;
+		}
+	}
+	started = true;
+
+	// colored stripes pulsing at a defined Beats-Per-Minute (BPM)
+	uint8_t BeatsPerMinute = 62;
+	CRGBPalette16 palette = PartyColors_p;
+	uint8_t beat = beatsin8(BeatsPerMinute, 64, 255);
+	for (int i = 0; i < controller->size(); i++)
+	{ //9948
+		leds[i] = ColorFromPalette(palette, hue + (i * 2), beat - hue + (i * 10));
+	}
+	if( hueTime == cmd->getHueUpdateTime() )
+	{
+		hueTime = 0;
+		hue +=1;
+	}
+
+	return cmd->getOnTime();
+}
+
+/**
+ * No clue how to explain this one
+ *
+ */
+void JuggleAnimation::begin(uint32_t now)
+{
+	//TODO: Figure out to better control hue update time
+
+	start(now);
+	controller->resetIntensity();
+	controller->fill(BLACK, false);
+}
+
+uint32_t JuggleAnimation::step(uint32_t now)
+{
+	if( started && isExpired(now) )
+	{
+		stop();
+		return 0;
+	}
+	started = true;
+
+	// eight colored dots, weaving in and out of sync with each other
+	fadeToBlackBy(leds, controller->size(), 20);
+	byte dothue = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		leds[beatsin16(i + 7, 0, controller->size())] |= CHSV(dothue, 200, 255);
+		dothue += 32;
+	}
+
+	return cmd->getOnTime();
+}
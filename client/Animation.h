@@ -0,0 +1,274 @@
+/*
+ * Animation.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#ifndef ANIMATION_H_
+#define ANIMATION_H_
+
+#include <Arduino.h>
+#include <FastLed.h>
+
+#include "ClientGlobal.h"
+#include "Command.h"
+#include "NeopixelWrapper.h"
+
+// Phases used by the stepped animations
+#define PHASE_ON		0
+#define PHASE_OFF		1
+#define PHASE_BOUNCE	2
+
+/**
+ * Base class for all animations.
+ *
+ * An animation is a resumable state object.  begin() sets up the state
+ * from the command; step() renders exactly one frame into the LED buffer
+ * and returns the number of milliseconds to wait before the next step.
+ * The animation engine calls show() after every step and owns all waiting,
+ * so an animation never blocks.
+ *
+ * An animation draws into the layer selected when it is attached.  The
+ * engine flags that layer as changed after every step unless the
+ * animation marks its own layers (marksDirty() returns true).
+ *
+ * Animations that only draw the on and off colors through the controller
+ * return true from usesPalette(); they also run on indexed pixels.
+ */
+class Animation
+{
+public:
+	Animation();
+	virtual ~Animation() {}
+
+	void attach(NeopixelWrapper* controller, Command* cmd);
+	uint8_t isRunning();
+	void stop();
+
+	virtual void begin(uint32_t now) = 0;
+	virtual uint32_t step(uint32_t now) = 0;
+	virtual void finish() {}
+	virtual uint8_t marksDirty() { return false; }
+	virtual uint8_t usesPalette() { return false; }
+
+protected:
+	NeopixelWrapper* controller;
+	Command* cmd;
+	CRGB* leds;
+	uint8_t running;
+	uint8_t started;
+	uint16_t count;
+	uint32_t endTime;
+
+	void start(uint32_t now);
+	uint8_t isComplete(uint32_t now);
+	uint8_t isExpired(uint32_t now);
+	uint8_t nextCycle(uint32_t now);
+	CRGB getOnColor();
+};
+
+class WipeAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+	uint8_t usesPalette() { return true; }
+protected:
+	int16_t index;
+	uint8_t phase;
+};
+
+class RotatePatternAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+	uint8_t usesPalette() { return true; }
+protected:
+	uint8_t pattern;
+};
+
+class ScrollPatternAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+	uint8_t usesPalette() { return true; }
+protected:
+	CRGB pixels[8];
+	uint8_t patternLength;
+	int16_t index;
+};
+
+class BounceAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+	uint8_t usesPalette() { return true; }
+protected:
+	uint8_t nextSweep(uint32_t now);
+	int16_t sweepStart(uint8_t sweep);
+	int16_t sweepEnd(uint8_t sweep);
+	int8_t sweepDirection(uint8_t sweep);
+
+	uint8_t patternLength;
+	uint8_t first;
+	uint8_t sweep;
+	uint8_t phase;
+	int16_t index;
+	int16_t lstart;
+	int16_t lend;
+	int16_t rstart;
+	int16_t rend;
+};
+
+class MiddleAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+	uint8_t usesPalette() { return true; }
+protected:
+	void setPixels(CRGB color);
+	uint16_t index;
+	uint8_t phase;
+};
+
+class RandomFlashAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+	uint8_t usesPalette() { return true; }
+protected:
+	uint16_t number;
+	uint8_t phase;
+};
+
+class FadeAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+protected:
+	int16_t level;
+};
+
+class StrobeAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+	uint8_t usesPalette() { return true; }
+protected:
+	uint8_t phase;
+};
+
+class LightningAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+	uint8_t usesPalette() { return true; }
+protected:
+	uint16_t flash;
+	uint32_t large;
+	uint8_t big;
+	uint8_t phase;
+};
+
+class StackAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+	uint8_t usesPalette() { return true; }
+protected:
+	void reset();
+	int16_t index;
+	int16_t pixel;
+	int16_t previous;
+	uint16_t placed;
+};
+
+class FillRandomAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+	uint8_t usesPalette() { return true; }
+protected:
+	uint16_t total;
+	uint16_t index;
+	uint8_t flag;
+	uint8_t phase;
+};
+
+class RainbowAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+	void finish();
+	uint8_t marksDirty() { return true; }
+protected:
+	uint8_t hue;
+	uint32_t hueTime;
+	CRGB* glitter;
+	int16_t glitterIndex;
+};
+
+class RainbowFadeAnimation : public Animation
+{
+public:
+	RainbowFadeAnimation();
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+protected:
+	uint16_t sPseudotime;
+	uint16_t sLastMillis;
+	uint16_t sHue16;
+};
+
+class ConfettiAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+protected:
+	uint8_t hue;
+	uint32_t hueTime;
+};
+
+class CylonAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+protected:
+	uint8_t hue;
+	uint32_t hueTime;
+	uint8_t flag;
+	int16_t position;
+};
+
+class BpmAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+protected:
+	uint8_t hue;
+	uint32_t hueTime;
+};
+
+class JuggleAnimation : public Animation
+{
+public:
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+};
+
+#endif /* ANIMATION_H_ */
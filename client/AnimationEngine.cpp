@@ -0,0 +1,312 @@
+/*
+ * AnimationEngine.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#include "AnimationEngine.h"
+#include "ProgramAnimation.h"
+
+// Only one animation runs at a time, so each one is allocated once
+static WipeAnimation wipeAnimation;
+static RotatePatternAnimation rotatePatternAnimation;
+static ScrollPatternAnimation scrollPatternAnimation;
+static BounceAnimation bounceAnimation;
+static MiddleAnimation middleAnimation;
+static RandomFlashAnimation randomFlashAnimation;
+static FadeAnimation fadeAnimation;
+static StrobeAnimation strobeAnimation;
+static LightningAnimation lightningAnimation;
+static StackAnimation stackAnimation;
+static FillRandomAnimation fillRandomAnimation;
+static RainbowAnimation rainbowAnimation;
+static RainbowFadeAnimation rainbowFadeAnimation;
+static ConfettiAnimation confettiAnimation;
+static CylonAnimation cylonAnimation;
+static BpmAnimation bpmAnimation;
+static JuggleAnimation juggleAnimation;
+static ProgramAnimation programAnimation;
+
+/**
+ * Constructor
+ */
+AnimationEngine::AnimationEngine()
+{
+	controller = 0;
+	animation = 0;
+	layer = LAYER_BASE;
+	transitionFrame = 0;
+	metrics = 0;
+}
+
+/**
+ * Initializes the engine
+ */
+void AnimationEngine::initialize(NeopixelWrapper* controller)
+{
+	this->controller = controller;
+	animation = 0;
+	programAnimation.setProgram(&program);
+}
+
+/**
+ * Sets the counters frames are recorded in
+ */
+void AnimationEngine::setMetrics(Metrics* metrics)
+{
+	this->metrics = metrics;
+}
+
+/**
+ * Starts the animation for the specified command.  Returns false if the
+ * command is not an animation.
+ *
+ */
+uint8_t AnimationEngine::start(Command* cmd)
+{
+	uint32_t now = millis();
+	Animation* a = select( cmd->getCommand() );
+
+	if( a == 0 )
+	{
+		return false;
+	}
+
+	if( controller->isIndexed() && !a->usesPalette() )
+	{
+		Serial.println(F("ERROR - animation needs RGB pixels"));
+		return false;
+	}
+
+	// Keep our own copy; the animation references it until complete
+	command = *cmd;
+
+	// Draw into the command's layer; the base if that layer is not enabled
+	layer = command.getLayer();
+	if( !controller->selectLayer(layer) )
+	{
+		layer = LAYER_BASE;
+		controller->selectLayer(layer);
+		command.setLayer(layer);
+	}
+
+	animation = a;
+	animation->attach(controller, &command);
+	animation->begin(now);
+	clock.start( micros() );
+	controller->resetFrameCounters();
+
+	// Invalid parameters stop the animation before the first frame
+	if( !animation->isRunning() )
+	{
+		animation->finish();
+		controller->markDirty(layer);
+		controller->show();
+		animation = 0;
+	}
+	controller->selectLayer(LAYER_BASE);
+
+	return true;
+}
+
+/**
+ * Stops the current animation; used when a new command preempts it.
+ */
+void AnimationEngine::stop()
+{
+	if( animation != 0 )
+	{
+		animation->stop();
+		animation->finish();
+		animation = 0;
+	}
+}
+
+/**
+ * Renders the next frame if it is due.  Returns true when the
+ * animation completed during this call.
+ *
+ */
+uint8_t AnimationEngine::run(uint32_t now)
+{
+	uint32_t wait;
+	uint32_t frameTime = micros();
+
+	if( animation == 0 || !clock.isDue(frameTime) )
+	{
+		// Keep a crossfade or the dither moving between animation frames
+		if( (controller->isTransitioning() && (now - transitionFrame) >= TRANSITION_INTERVAL) ||
+			(controller->isDithering() && (now - transitionFrame) >= DITHER_INTERVAL) )
+		{
+			transitionFrame = now;
+			controller->show();
+		}
+		return false;
+	}
+
+	controller->selectLayer(layer);
+	wait = animation->step(now);
+	if( !animation->marksDirty() )
+	{
+		controller->markDirty(layer);
+	}
+	if( !animation->isRunning() )
+	{
+		animation->finish();
+	}
+	controller->selectLayer(LAYER_BASE);
+	uint32_t shown = controller->getShownFrames();
+	uint32_t showStart = micros();
+	controller->show();
+	clock.tick(frameTime);
+	if( metrics != 0 )
+	{
+		metrics->recordFrame( clock.getLateness(), micros() - showStart, controller->getShownFrames() != shown );
+	}
+
+	if( !animation->isRunning() )
+	{
+		animation = 0;
+		return true;
+	}
+
+	// Next deadline is relative to this deadline, not to now
+	if( wait > FRAME_MAX_INTERVAL/1000 )
+	{
+		wait = FRAME_MAX_INTERVAL/1000;
+	}
+	clock.schedule(frameTime, wait * 1000);
+
+	return false;
+}
+
+/**
+ * Waits for the next frame.  Sleeps until the frame deadline, but never
+ * longer than the service interval so the network keeps being serviced.
+ *
+ */
+void AnimationEngine::idle()
+{
+	if( animation != 0 )
+	{
+		clock.sleep(FRAME_SERVICE_INTERVAL);
+	}
+	else
+	{
+		delay(1);
+	}
+}
+
+/**
+ * Returns true if an animation is active
+ */
+uint8_t AnimationEngine::isRunning()
+{
+	return (animation != 0);
+}
+
+/**
+ * Returns true if the next frame of the animation should be rendered
+ */
+uint8_t AnimationEngine::isDue()
+{
+	return ( animation != 0 && clock.isDue( micros() ) );
+}
+
+/**
+ * Returns true if the command is rendered by an animation
+ */
+uint8_t AnimationEngine::isAnimation(uint8_t c)
+{
+	return ( select(c) != 0 );
+}
+
+/**
+ * Returns the layer the animation draws into
+ */
+uint8_t AnimationEngine::getLayer()
+{
+	return layer;
+}
+
+/**
+ * Returns the command being animated
+ */
+Command* AnimationEngine::getCommand()
+{
+	return &command;
+}
+
+/**
+ * Returns the frame clock; holds the frame statistics of the last command
+ */
+FrameClock* AnimationEngine::getClock()
+{
+	return &clock;
+}
+
+/**
+ * Returns the store for the bytecode program
+ */
+Program* AnimationEngine::getProgram()
+{
+	return &program;
+}
+
+/**
+ * Prints the frame statistics of the last command
+ */
+void AnimationEngine::dump()
+{
+	clock.dump();
+	controller->dumpFrames();
+}
+
+/**
+ * Returns the animation for the command; NULL if not an animation
+ */
+Animation* AnimationEngine::select(uint8_t c)
+{
+	switch( c )
+	{
+	case CMD_PATTERN:
+		return &rotatePatternAnimation;
+	case CMD_WIPE:
+		return &wipeAnimation;
+	case CMD_SCROLL:
+		return &scrollPatternAnimation;
+	case CMD_BOUNCE:
+		return &bounceAnimation;
+	case CMD_MIDDLE:
+		return &middleAnimation;
+	case CMD_RANDOM_FLASH:
+		return &randomFlashAnimation;
+	case CMD_FADE:
+		return &fadeAnimation;
+	case CMD_STROBE:
+		return &strobeAnimation;
+	case CMD_LIGHTNING:
+		return &lightningAnimation;
+	case CMD_STACK:
+		return &stackAnimation;
+	case CMD_FILL_RANDOM:
+		return &fillRandomAnimation;
+	case CMD_RAINBOW:
+		return &rainbowAnimation;
+	case CMD_RAINBOW_FADE:
+		return &rainbowFadeAnimation;
+	case CMD_CONFETTI:
+		return &confettiAnimation;
+	case CMD_CYLON:
+		return &cylonAnimation;
+	case CMD_BPM:
+		return &bpmAnimation;
+	case CMD_JUGGLE:
+		return &juggleAnimation;
+	case CMD_RUN_PROGRAM:
+		return &programAnimation;
+	default:
+		return 0;
+	}
+}
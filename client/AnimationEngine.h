@@ -0,0 +1,64 @@
+/*
+ * AnimationEngine.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#ifndef ANIMATIONENGINE_H_
+#define ANIMATIONENGINE_H_
+
+#include <Arduino.h>
+
+#include "ClientGlobal.h"
+#include "Animation.h"
+#include "Command.h"
+#include "FrameClock.h"
+#include "Metrics.h"
+#include "NeopixelWrapper.h"
+#include "Program.h"
+
+/**
+ * Frame scheduler for the animations.
+ *
+ * Holds the command currently being animated and advances its animation
+ * one step at a time from loop().  The engine decides when a frame is due
+ * and pushes every rendered frame to the LEDs; between frames control goes
+ * back to loop() so the network is serviced.  Frames are timed by a
+ * FrameClock against absolute deadlines.
+ */
+class AnimationEngine
+{
+public:
+	AnimationEngine();
+	void initialize(NeopixelWrapper* controller);
+	void setMetrics(Metrics* metrics);
+
+	uint8_t start(Command* cmd);
+	void stop();
+	uint8_t run(uint32_t now);
+	void idle();
+
+	uint8_t isRunning();
+	uint8_t isDue();
+	uint8_t isAnimation(uint8_t c);
+	uint8_t getLayer();
+	Command* getCommand();
+	FrameClock* getClock();
+	Program* getProgram();
+	void dump();
+
+protected:
+	NeopixelWrapper* controller;
+	Animation* animation;
+	uint8_t layer;
+	uint32_t transitionFrame;
+	Command command;
+	FrameClock clock;
+	Program program;
+	Metrics* metrics;
+
+	Animation* select(uint8_t c);
+};
+
+#endif /* ANIMATIONENGINE_H_ */
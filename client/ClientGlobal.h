@@ -67,6 +67,48 @@ enum ComponentEnum {Config=0, Queue, Wifi, Driver, General };
 
 #endif
 
+// LED outputs; the logical strip is split across the segments in order.
+// A segment length of 0 shares the LEDs left over by the fixed segments.
+#define MY_NUMBER_SEGMENTS	1
+//#define MY_NUMBER_SEGMENTS	4
+
+#define MY_SEGMENT_PIN_0	MY_LED_PIN
+#define MY_SEGMENT_PIN_1	13
+#define MY_SEGMENT_PIN_2	12
+#define MY_SEGMENT_PIN_3	14
+
+#define MY_SEGMENT_LENGTH_0	0
+#define MY_SEGMENT_LENGTH_1	0
+#define MY_SEGMENT_LENGTH_2	0
+#define MY_SEGMENT_LENGTH_3	0
+
+// Drives all segments at once from GPIO12 up (WS2811_PORTA); segment pins
+// and lengths are ignored and the strip is split into equal lanes
+//#define MY_PARALLEL_OUTPUT
+
+// Stores one palette index per LED instead of RGB and expands each segment
+// while it is sent.  Only the on/off color effects are available and
+// overlay layers are disabled.  The segment being sent is staged as RGB,
+// so this needs several segments: N equal ones cost 1 + 3/N bytes per LED.
+//#define MY_INDEXED_PIXELS
+
+// Sends colors through a gamma/white balance/intensity table instead of
+// FastLED's linear scaling; dithering recovers the low levels over frames
+//#define MY_GAMMA_CORRECTION
+//#define MY_TEMPORAL_DITHER
+
+// Realtime pixels over UDP (E1.31 and Art-Net).  The node takes the
+// universes from MY_UDP_UNIVERSE up, 170 pixels each.
+#define MY_UDP_UNIVERSE		1
+
+// How long the last UDP frame is held once the sender stops before the
+// LEDs are cleared (ms); 0 holds it until something else is drawn
+#define MY_UDP_HOLD_TIME	2500
+
+// Time between metrics snapshots on the response channel (ms); 0 sends
+// none until CMD_SET_METRICS asks for them
+#define MY_METRICS_INTERVAL	60000
+
 
 // What HW platform are we dealing with?
 #ifdef __HOST_ESP8266
@@ -0,0 +1,157 @@
+/*
+ * ClockSync.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#include "ClockSync.h"
+
+/**
+ * Constructor
+ */
+ClockSync::ClockSync()
+{
+	reset();
+}
+
+/**
+ * Forgets all samples
+ */
+void ClockSync::reset()
+{
+	for(uint8_t i=0; i<SYNC_SAMPLES; i++)
+	{
+		offsets[i] = 0;
+		delays[i] = 0;
+	}
+	samples = 0;
+	nextSample = 0;
+	offset = 0;
+	delay = 0;
+	lastPing = 0;
+	pingOutstanding = false;
+}
+
+/**
+ * Returns true if it is time to ping the controller
+ */
+uint8_t ClockSync::isPingDue(uint32_t now)
+{
+	uint32_t interval = isSynced() ? SYNC_INTERVAL : SYNC_FAST_INTERVAL;
+
+	return ( lastPing == 0 || (now - lastPing) >= interval );
+}
+
+/**
+ * Records the local time a ping was sent
+ */
+void ClockSync::pingSent(uint32_t now)
+{
+	lastPing = now;
+	pingOutstanding = true;
+}
+
+/**
+ * Adds the controller's reply to the last ping.  Origin is the local
+ * send time echoed back, remote the controller's time and now the local
+ * receive time.  Returns false if the reply was not usable.
+ *
+ */
+uint8_t ClockSync::sample(uint32_t origin, uint32_t remote, uint32_t now)
+{
+	uint32_t d = now - origin;
+
+	// Only the reply to the last ping counts; late duplicates are stale
+	if( !pingOutstanding || origin != lastPing || d > SYNC_MAX_DELAY )
+	{
+		return false;
+	}
+	pingOutstanding = false;
+
+	offsets[nextSample] = (int32_t)(remote + d/2 - now);
+	delays[nextSample] = d;
+	nextSample = (nextSample + 1) % SYNC_SAMPLES;
+	if( samples < SYNC_SAMPLES )
+	{
+		samples += 1;
+	}
+
+	// Trust the sample with the least time spent in the network
+	uint8_t best = 0;
+	for(uint8_t i=1; i<samples; i++)
+	{
+		if( delays[i] < delays[best] )
+		{
+			best = i;
+		}
+	}
+	offset = offsets[best];
+	delay = delays[best];
+
+	return true;
+}
+
+/**
+ * Returns true once enough samples were taken to trust the offset
+ */
+uint8_t ClockSync::isSynced()
+{
+	return (samples >= SYNC_MIN_SAMPLES);
+}
+
+/**
+ * Returns the controller's time now
+ */
+uint32_t ClockSync::getTime()
+{
+	return toShared( millis() );
+}
+
+/**
+ * Converts a local time to the controller's time
+ */
+uint32_t ClockSync::toShared(uint32_t local)
+{
+	return local + offset;
+}
+
+/**
+ * Returns true if the controller's time reached the given time.  Until
+ * synced there is no shared time, so everything is due.
+ *
+ */
+uint8_t ClockSync::isDue(uint32_t at)
+{
+	return ( !isSynced() || (int32_t)(getTime() - at) >= 0 );
+}
+
+/**
+ * Returns the offset from local to controller time (ms)
+ */
+int32_t ClockSync::getOffset()
+{
+	return offset;
+}
+
+/**
+ * Returns the round trip of the sample the offset came from (ms)
+ */
+uint32_t ClockSync::getDelay()
+{
+	return delay;
+}
+
+/**
+ * Prints the clock state
+ */
+void ClockSync::dump()
+{
+	Serial.print(F("Clock - synced: "));
+	Serial.print( isSynced() );
+	Serial.print(F(", offset: "));
+	Serial.print( offset );
+	Serial.print(F(" ms, delay: "));
+	Serial.print( delay );
+	Serial.println(F(" ms"));
+}
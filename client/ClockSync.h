@@ -0,0 +1,70 @@
+/*
+ * ClockSync.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#ifndef CLOCKSYNC_H_
+#define CLOCKSYNC_H_
+
+#include <Arduino.h>
+
+#include "ClientGlobal.h"
+
+// Samples kept; the one with the shortest round trip sets the offset
+#define SYNC_SAMPLES		8
+
+// Samples needed before scheduled commands wait for their time
+#define SYNC_MIN_SAMPLES	3
+
+// Time between pings (ms); faster until synced
+#define SYNC_INTERVAL		30000
+#define SYNC_FAST_INTERVAL	1000
+
+// Replies slower than this are too uncertain to use (ms)
+#define SYNC_MAX_DELAY		500
+
+/**
+ * Estimates the offset between millis() and the controller's clock.
+ *
+ * The node pings with its local send time; the controller answers with
+ * that time and its own.  Assuming the delay is the same both ways, the
+ * controller's clock read halfway through the round trip gives the
+ * offset.  Queueing delay on the broker is never symmetric, so of the
+ * recent samples the one with the shortest round trip is trusted.
+ *
+ * All times are passed in, so the estimator does not depend on the
+ * hardware clock.
+ */
+class ClockSync
+{
+public:
+	ClockSync();
+	void reset();
+
+	uint8_t isPingDue(uint32_t now);
+	void pingSent(uint32_t now);
+	uint8_t sample(uint32_t origin, uint32_t remote, uint32_t now);
+
+	uint8_t isSynced();
+	uint32_t getTime();
+	uint32_t toShared(uint32_t local);
+	uint8_t isDue(uint32_t at);
+
+	int32_t getOffset();
+	uint32_t getDelay();
+	void dump();
+
+protected:
+	int32_t offsets[SYNC_SAMPLES];
+	uint32_t delays[SYNC_SAMPLES];
+	uint8_t samples;
+	uint8_t nextSample;
+	int32_t offset;
+	uint32_t delay;
+	uint32_t lastPing;
+	uint8_t pingOutstanding;
+};
+
+#endif /* CLOCKSYNC_H_ */
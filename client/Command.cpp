@@ -48,6 +48,35 @@ void Command::initialize()
 	fadeIncrement = 0;
 	index = 0;
 	show = false;
+	preempt = false;
+	priority = 0;
+	batch = BATCH_NONE;
+	atomic = false;
+	batchStart = 0;
+	programStart = 0;
+	programLength = 0;
+	presetStart = 0;
+	presetLength = 0;
+	relayNodeSize = 0;
+	relayFanout = 0;
+	relayOffset = 0;
+	nodeIdStart = 0;
+	nodeIdLength = 0;
+	relayStart = 0;
+	relayLength = 0;
+	layer = LAYER_BASE;
+	blend = BLEND_REPLACE;
+	alpha = 255;
+	transitionTime = 0;
+	executeAt = 0;
+	receiveTime = 0;
+	syncOrigin = 0;
+	syncTime = 0;
+	powerPeak = 0;
+	powerScale = 100;
+	queueDepth = 0;
+	queueDropped = 0;
+	duplicates = 0;
 
 	for(uint8_t i=0; i<MAX_RELAY_NODES; i++)
 	{
@@ -57,82 +86,367 @@ void Command::initialize()
 } // end initialize
 
 /**
- * Parses buffer into object
+ * Parses buffer into object; the first byte tells binary from JSON
  *
  */
-uint8_t Command::parse(uint8_t* b)
+uint8_t Command::parse(uint8_t* b, uint16_t length)
 {
-	uint8_t status = 0;
+	if( length > 0 && b[0] == BINARY_VERSION )
+	{
+		return parseBinary(b, length);
+	}
+	return parseJson(b, length);
+}
+
+// Case for a numeric key; the name is compared only when the hash matches
+#define JSON_FIELD(k, f)	case jsonKey(k): if( r.isKey(k) ) { f = r.readNumber(); continue; } break;
+
+/**
+ * Parses a JSON buffer into object in a single pass, in place.  Keys are
+ * dispatched on their hash; unknown keys are skipped and missing keys
+ * are cleared.
+ *
+ */
+uint8_t Command::parseJson(const uint8_t* b, uint16_t length)
+{
+	JsonReader r(b, length);
 
 #ifdef __DEBUG
 	Serial.println("Parsing buffer...");
 #endif
 
-	StaticJsonBuffer<CMD_BUFFER_SIZE> jsonBuffer;
-	JsonObject& obj = jsonBuffer.parseObject((char *)b);
-	if (!obj.success())
+	command = 0;
+	uniqueId = 0;
+	nodeId = 0;
+	notifyOnComplete = 0;
+	relay = 0;
+	nodeIdStart = 0;
+	nodeIdLength = 0;
+	relayStart = 0;
+	relayLength = 0;
+	show = 0;
+	clearAfter = 0;
+	clearEnd = 0;
+	preempt = 0;
+	atomic = 0;
+	batchStart = 0;
+	clearFields();
+
+	while( r.nextKey() )
 	{
-#ifdef __DEBUG
-		Serial.print(F("parseObject() failed: "));
-		Serial.println(obj.success());
-#endif
-		return status;
+		switch( r.getKeyHash() )
+		{
+		JSON_FIELD(KEY_CMD, command)
+		JSON_FIELD(KEY_UNIQUE_ID, uniqueId)
+		JSON_FIELD(KEY_NOTIFY_ON_COMPLETE, notifyOnComplete)
+		JSON_FIELD(KEY_RELAY, relay)
+		JSON_FIELD(KEY_SHOW, show)
+		JSON_FIELD(KEY_FPS, framesPerSecond)
+		JSON_FIELD(KEY_UPDATE_TIME, hueUpdateTime)
+		JSON_FIELD(KEY_INTENSITY, intensity)
+		JSON_FIELD(KEY_INDEX, index)
+		JSON_FIELD(KEY_PATTERN, pattern)
+		JSON_FIELD(KEY_PATTERN_LENGTH, patternLength)
+		JSON_FIELD(KEY_DURATION, duration)
+		JSON_FIELD(KEY_REPEAT, repeat)
+		JSON_FIELD(KEY_DIRECTION, direction)
+		JSON_FIELD(KEY_FADE_BY, fadeBy)
+		JSON_FIELD(KEY_PROBABILITY, probability)
+		JSON_FIELD(KEY_CLEAR_AFTER, clearAfter)
+		JSON_FIELD(KEY_CLEAR_END, clearEnd)
+		JSON_FIELD(KEY_ON_COLOR, onColor)
+		JSON_FIELD(KEY_OFF_COLOR, offColor)
+		JSON_FIELD(KEY_ON_TIME, onTime)
+		JSON_FIELD(KEY_OFF_TIME, offTime)
+		JSON_FIELD(KEY_BOUNCE_TIME, bounceTime)
+		JSON_FIELD(KEY_FADE_TIME, fadeTime)
+		JSON_FIELD(KEY_FADE_INCREMENT, fadeIncrement)
+		JSON_FIELD(KEY_NUMBER, number)
+		JSON_FIELD(KEY_LAYER, layer)
+		JSON_FIELD(KEY_BLEND, blend)
+		JSON_FIELD(KEY_ALPHA, alpha)
+		JSON_FIELD(KEY_TRANSITION_TIME, transitionTime)
+		JSON_FIELD(KEY_PRIORITY, priority)
+		JSON_FIELD(KEY_PREEMPT, preempt)
+		JSON_FIELD(KEY_ATOMIC, atomic)
+		JSON_FIELD(KEY_EXECUTE_AT, executeAt)
+		JSON_FIELD(KEY_SYNC_ORIGIN, syncOrigin)
+		JSON_FIELD(KEY_SYNC_TIME, syncTime)
+		JSON_FIELD(KEY_RELAY_FANOUT, relayFanout)
+		JSON_FIELD(KEY_RELAY_OFFSET, relayOffset)
+		case jsonKey(KEY_NODE_ID):
+			// Relays patch the node id in place, so remember where it is
+			if( r.isKey(KEY_NODE_ID) )
+			{
+				nodeIdStart = r.getOffset();
+				nodeId = r.readNumber();
+				nodeIdLength = r.getOffset() - nodeIdStart;
+				continue;
+			}
+			break;
+		case jsonKey(KEY_RELAY_NODES):
+			if( r.isKey(KEY_RELAY_NODES) )
+			{
+				relayStart = r.getOffset();
+				relayNodeSize = r.readArray(relayNodes, MAX_RELAY_NODES);
+				relayLength = r.getOffset() - relayStart;
+				continue;
+			}
+			break;
+		case jsonKey(KEY_BATCH):
+			// Commands of a batch are parsed by the caller once the rest
+			// of the message is known
+			if( r.isKey(KEY_BATCH) )
+			{
+				batchStart = r.getOffset();
+			}
+			break;
+		case jsonKey(KEY_PROGRAM):
+			// Loaded by the caller straight from the payload
+			if( r.isKey(KEY_PROGRAM) )
+			{
+				programStart = r.getOffset();
+				r.skipValue();
+				programLength = r.getOffset() - programStart;
+				continue;
+			}
+			break;
+		case jsonKey(KEY_PRESET):
+			// Stored by the caller straight from the payload
+			if( r.isKey(KEY_PRESET) )
+			{
+				presetStart = r.getOffset();
+				r.skipValue();
+				presetLength = r.getOffset() - presetStart;
+				continue;
+			}
+			break;
+		}
+		r.skipValue();
 	}
-	else
+
+	if( !r.isValid() )
 	{
 #ifdef __DEBUG
-		Serial.println("Successful parse; pulling values...");
+		Serial.println(F("parse failed"));
 #endif
+		return false;
+	}
+
+	return true;
 
-		command = obj[KEY_CMD].as<uint8_t>();
-		uniqueId = obj[KEY_UNIQUE_ID].as<long>();
-		nodeId = obj[KEY_NODE_ID].as<uint8_t>();
-		notifyOnComplete = obj[KEY_NOTIFY_ON_COMPLETE].as<uint8_t>();
-		relay = obj[KEY_RELAY].as<uint8_t>();
-		show = obj[KEY_SHOW].as<uint8_t>();
-
-		framesPerSecond = obj[KEY_FPS].as<uint8_t>();
-		hueUpdateTime = obj[KEY_UPDATE_TIME].as<uint8_t>();
-		intensity = obj[KEY_INTENSITY].as<uint8_t>();
-
-		index = obj[KEY_INDEX].as<uint8_t>();
-		pattern = obj[KEY_PATTERN].as<uint8_t>();
-		patternLength = obj[KEY_PATTERN_LENGTH].as<uint8_t>();
-		duration = obj[KEY_DURATION].as<uint32_t>();
-		repeat = obj[KEY_REPEAT].as<uint16_t>();
-		direction = obj[KEY_DIRECTION].as<uint8_t>();
-		fadeBy = obj[KEY_FADE_BY].as<uint8_t>();
-		probability = obj[KEY_PROBABILITY].as<uint8_t>();
-		clearAfter = obj[KEY_CLEAR_AFTER].as<uint8_t>();
-		clearEnd = obj[KEY_CLEAR_END].as<uint8_t>();
-
-		onColor = obj[KEY_ON_COLOR].as<uint32_t>();
-		offColor = obj[KEY_OFF_COLOR].as<uint32_t>();
-		onTime = obj[KEY_ON_TIME].as<uint32_t>();
-		offTime = obj[KEY_OFF_TIME].as<uint32_t>();
-		bounceTime = obj[KEY_BOUNCE_TIME].as<uint32_t>();
-		fadeTime = obj[KEY_FADE_TIME].as<uint32_t>();
-		fadeIncrement = obj[KEY_FADE_INCREMENT].as<uint8_t>();
-		number = obj[KEY_NUMBER].as<uint8_t>();
-
-		if( obj.containsKey(KEY_RELAY_NODES) )
+} // end parseJson
+
+/**
+ * Returns the unique id of a message without parsing the rest; read from
+ * the header of binary messages and by skipping keys up to it in JSON.
+ * Returns 0 if the message has no unique id.
+ *
+ */
+uint32_t Command::peekUniqueId(const uint8_t* b, uint16_t length)
+{
+	if( length > 0 && b[0] == BINARY_VERSION )
+	{
+		if( length < BINARY_HEADER_SIZE )
+		{
+			return 0;
+		}
+		return (uint32_t)b[2] | ((uint32_t)b[3] << 8) | ((uint32_t)b[4] << 16) | ((uint32_t)b[5] << 24);
+	}
+
+	JsonReader r(b, length);
+	while( r.nextKey() )
+	{
+		if( r.getKeyHash() == jsonKey(KEY_UNIQUE_ID) && r.isKey(KEY_UNIQUE_ID) )
 		{
-			relayNodeSize = 0;
-			JsonArray& nestedArray = obj[KEY_RELAY_NODES].asArray();
-			for(uint8_t i=0; i<nestedArray.size(); i++ )
+			return r.readNumber();
+		}
+		r.skipValue();
+	}
+
+	return 0;
+}
+
+/**
+ * Parses a binary buffer into object in a single pass.  Fields that are
+ * not sent are cleared, same as keys missing from JSON.
+ *
+ */
+uint8_t Command::parseBinary(uint8_t* b, uint16_t length)
+{
+	// Width of each field, indexed by field bit; 0 = variable
+	static const uint8_t widths[NUMBER_FIELDS] = { 1, 1, 1, 2, 1, 1, 4, 2, 1, 1, 1, 3, 3, 4, 4, 4, 4, 1, 1, 1, 1, 1, 4, 0, 1, 4, 1, 4, 0, 0 };
+	uint8_t *p = b + BINARY_HEADER_SIZE;
+	uint8_t *end = b + length;
+	uint32_t fields;
+	uint32_t v;
+	uint8_t flags;
+
+	if( length < BINARY_HEADER_SIZE )
+	{
+		Serial.println(F("ERROR - binary command too short"));
+		return false;
+	}
+
+	clearFields();
+	command = b[1];
+	uniqueId = (uint32_t)b[2] | ((uint32_t)b[3] << 8) | ((uint32_t)b[4] << 16) | ((uint32_t)b[5] << 24);
+	nodeId = b[6];
+	nodeIdStart = 6;
+	nodeIdLength = 1;
+	flags = b[7];
+	fields = (uint32_t)b[8] | ((uint32_t)b[9] << 8) | ((uint32_t)b[10] << 16) | ((uint32_t)b[11] << 24);
+
+	notifyOnComplete = (flags & FLAG_NOTIFY_ON_COMPLETE) ? true : false;
+	relay = RELAY_NONE;
+	if( flags & FLAG_RELAY )
+	{
+		relay = (flags & FLAG_RELAY_ON_RECEIPT) ? RELAY_ON_RECEIPT : RELAY_ON_COMPLETE;
+	}
+	show = (flags & FLAG_SHOW) ? true : false;
+	clearAfter = (flags & FLAG_CLEAR_AFTER) ? true : false;
+	clearEnd = (flags & FLAG_CLEAR_END) ? true : false;
+	preempt = (flags & FLAG_PREEMPT) ? true : false;
+
+	for(uint8_t f=0; f<NUMBER_FIELDS && fields != 0; f++, fields >>= 1)
+	{
+		if( (fields & 0x01) == 0 )
+		{
+			continue;
+		}
+
+		if( f == FIELD_RELAY_NODES )
+		{
+			if( p >= end || p + 1 + *p > end || *p > MAX_RELAY_NODES )
 			{
-				relayNodes[i] = nestedArray[i].as<uint8_t>();
-				relayNodeSize += 1;
+				Serial.println(F("ERROR - bad relay nodes"));
+				return false;
 			}
+			relayStart = p - b;
+			relayLength = 1 + *p;
+			relayNodeSize = *p++;
+			memcpy(relayNodes, p, relayNodeSize);
+			p += relayNodeSize;
+			continue;
 		}
 
-		status = true;
+		if( f == FIELD_PROGRAM || f == FIELD_PRESET )
+		{
+			if( p + 2 > end || p + 2 + (p[0] | (p[1] << 8)) > end )
+			{
+				Serial.println(F("ERROR - bad program or preset"));
+				return false;
+			}
+			if( f == FIELD_PROGRAM )
+			{
+				programLength = p[0] | (p[1] << 8);
+				programStart = (p + 2) - b;
+			}
+			else
+			{
+				presetLength = p[0] | (p[1] << 8);
+				presetStart = (p + 2) - b;
+			}
+			p += 2 + (p[0] | (p[1] << 8));
+			continue;
+		}
+
+		if( p + widths[f] > end )
+		{
+			Serial.println(F("ERROR - binary command truncated"));
+			return false;
+		}
+
+		// colors are sent R, G, B; everything else little endian
+		v = 0;
+		if( f == FIELD_ON_COLOR || f == FIELD_OFF_COLOR )
+		{
+			v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+		}
+		else
+		{
+			for(uint8_t i=0; i<widths[f]; i++)
+			{
+				v |= (uint32_t)p[i] << (8*i);
+			}
+		}
+		p += widths[f];
 
+		switch(f)
+		{
+		case FIELD_FPS:				framesPerSecond = v; break;
+		case FIELD_UPDATE_TIME:		hueUpdateTime = v; break;
+		case FIELD_INTENSITY:		intensity = v; break;
+		case FIELD_INDEX:			index = v; break;
+		case FIELD_PATTERN:			pattern = v; break;
+		case FIELD_PATTERN_LENGTH:	patternLength = v; break;
+		case FIELD_DURATION:		duration = v; break;
+		case FIELD_REPEAT:			repeat = v; break;
+		case FIELD_DIRECTION:		direction = v; break;
+		case FIELD_FADE_BY:			fadeBy = v; break;
+		case FIELD_PROBABILITY:		probability = v; break;
+		case FIELD_ON_COLOR:		onColor = v; break;
+		case FIELD_OFF_COLOR:		offColor = v; break;
+		case FIELD_ON_TIME:			onTime = v; break;
+		case FIELD_OFF_TIME:		offTime = v; break;
+		case FIELD_BOUNCE_TIME:		bounceTime = v; break;
+		case FIELD_FADE_TIME:		fadeTime = v; break;
+		case FIELD_FADE_INCREMENT:	fadeIncrement = v; break;
+		case FIELD_NUMBER:			number = v; break;
+		case FIELD_LAYER:			layer = v; break;
+		case FIELD_BLEND:			blend = v; break;
+		case FIELD_ALPHA:			alpha = v; break;
+		case FIELD_TRANSITION_TIME:	transitionTime = v; break;
+		case FIELD_PRIORITY:		priority = v; break;
+		case FIELD_EXECUTE_AT:		executeAt = v; break;
+		case FIELD_RELAY_FANOUT:	relayFanout = v; break;
+		case FIELD_RELAY_OFFSET:	relayOffset = v; break;
+		}
 	}
 
-	return status;
+	return true;
 
-} // end parse
+} // end parseBinary
+
+/**
+ * Clears the fields a message carries
+ */
+void Command::clearFields()
+{
+	framesPerSecond = 0;
+	hueUpdateTime = 0;
+	intensity = 0;
+	index = 0;
+	pattern = 0;
+	patternLength = 0;
+	duration = 0;
+	repeat = 0;
+	direction = 0;
+	fadeBy = 0;
+	probability = 0;
+	onColor = 0;
+	offColor = 0;
+	onTime = 0;
+	offTime = 0;
+	bounceTime = 0;
+	fadeTime = 0;
+	fadeIncrement = 0;
+	number = 0;
+	layer = LAYER_BASE;
+	blend = BLEND_REPLACE;
+	alpha = 255;
+	transitionTime = 0;
+	priority = 0;
+	executeAt = 0;
+	syncOrigin = 0;
+	syncTime = 0;
+	relayFanout = 0;
+	relayOffset = 0;
+	programStart = 0;
+	programLength = 0;
+	presetStart = 0;
+	presetLength = 0;
+}
 
 uint8_t Command::buildCommand(uint8_t *buffer)
 {
@@ -146,13 +460,21 @@ uint8_t Command::buildCommand(uint8_t *buffer)
 	root[KEY_NODE_ID] = nodeId;
 	root[KEY_NOTIFY_ON_COMPLETE] = notifyOnComplete;
 	root[KEY_RELAY] = relay;
-	if( relay == true )
+	if( relay != RELAY_NONE )
 	{
 		JsonArray&  nestedArray  = root.createNestedArray(KEY_RELAY_NODES);
 		for(uint8_t i = 0; i<relayNodeSize; i++)
 		{
 			nestedArray.add(relayNodes[i]);
 		}
+		if( relayFanout > 1 )
+		{
+			root[KEY_RELAY_FANOUT] = relayFanout;
+		}
+		if( relayOffset > 0 )
+		{
+			root[KEY_RELAY_OFFSET] = relayOffset;
+		}
 	}
 	root[KEY_SHOW] = show;
 	root[KEY_FPS] = framesPerSecond;
@@ -176,6 +498,29 @@ uint8_t Command::buildCommand(uint8_t *buffer)
 	root[KEY_FADE_TIME] = fadeTime;
 	root[KEY_FADE_INCREMENT] = fadeIncrement;
 	root[KEY_NUMBER] = number;
+	if( layer != LAYER_BASE )
+	{
+		// only sent when used; keeps the relayed command within the JSON buffer
+		root[KEY_LAYER] = layer;
+		root[KEY_BLEND] = blend;
+		root[KEY_ALPHA] = alpha;
+	}
+	if( transitionTime > 0 )
+	{
+		root[KEY_TRANSITION_TIME] = transitionTime;
+	}
+	if( priority > 0 )
+	{
+		root[KEY_PRIORITY] = priority;
+	}
+	if( preempt )
+	{
+		root[KEY_PREEMPT] = preempt;
+	}
+	if( executeAt > 0 )
+	{
+		root[KEY_EXECUTE_AT] = executeAt;
+	}
 
 	root[KEY_REPEAT] = repeat;
 	root[KEY_DURATION] = duration;
@@ -207,6 +552,16 @@ uint8_t Command::buildResponse(uint8_t *buffer)
 	// Status of command (SUCCESS/FAIL)
 	root[KEY_STATUS] = STATUS_SUCCESS;
 
+	// Estimated peak draw (mA) and the lowest intensity scale (%) the
+	// power limiter applied while the command ran
+	root[KEY_POWER_PEAK] = powerPeak;
+	root[KEY_POWER_SCALE] = powerScale;
+
+	// Commands waiting behind this one and commands dropped so far
+	root[KEY_QUEUE_DEPTH] = queueDepth;
+	root[KEY_QUEUE_DROPPED] = queueDropped;
+	root[KEY_DUPLICATES] = duplicates;
+
 	root.printTo((char *)buffer, CMD_BUFFER_SIZE);
 	Helper::workYield(); // Give time to ESP
 
@@ -215,6 +570,141 @@ uint8_t Command::buildResponse(uint8_t *buffer)
 	return status;
 }
 
+/**
+ * Builds a clock sync ping; the controller echoes the origin time back
+ * with its own time
+ */
+uint8_t Command::buildSync(uint8_t *buffer)
+{
+	StaticJsonBuffer<CMD_BUFFER_SIZE> jsonBuffer;
+	JsonObject& root = jsonBuffer.createObject();
+
+	root[KEY_CMD] = CMD_SYNC;
+	root[KEY_NODE_ID] = getNodeId();
+	root[KEY_SYNC_ORIGIN] = syncOrigin;
+
+	root.printTo((char *)buffer, CMD_BUFFER_SIZE);
+
+	return true;
+}
+
+/**
+ * Splits the relay list between the nodes we relay to.  With a fanout of
+ * k the list is cut into k nearly equal runs; the first node of each run
+ * is relayed to and gets the rest of the run as its relay list, so the
+ * command reaches N nodes in about log k (N) hops.  A fanout of 0 or 1 is
+ * the plain chain.  Returns false if there is no such child.
+ *
+ */
+uint8_t Command::getRelayChild(uint8_t child, uint8_t* dest, uint8_t* first, uint8_t* size)
+{
+	uint8_t k = (relayFanout > 1) ? relayFanout : 1;
+	uint8_t run;
+	uint8_t extra;
+	uint8_t start;
+
+	if( k > relayNodeSize )
+	{
+		k = relayNodeSize;
+	}
+	if( child >= k )
+	{
+		return false;
+	}
+
+	run = relayNodeSize / k;
+	extra = relayNodeSize % k;
+	start = child * run + ( (child < extra) ? child : extra );
+	if( child < extra )
+	{
+		run += 1;
+	}
+
+	*dest = relayNodes[start];
+	*first = start + 1;
+	*size = run - 1;
+
+	return true;
+}
+
+/**
+ * Builds the command relayed to a node from the payload it arrived in:
+ * the node id and relay list are replaced in place and everything else
+ * is passed on as received, JSON or binary.  Nodes is the run of the
+ * relay list given by getRelayChild().  Returns the length built; 0 if
+ * it does not fit the buffer.
+ *
+ */
+uint16_t Command::buildRelay(const uint8_t* payload, uint16_t length, uint8_t dest, uint8_t first, uint8_t size, uint8_t* buffer)
+{
+	uint8_t idText[4];
+	uint8_t listText[2 + 4*MAX_RELAY_NODES];
+	uint16_t idLength = 0;
+	uint16_t listLength = 0;
+	uint16_t start[2] = { nodeIdStart, relayStart };
+	uint16_t span[2] = { nodeIdLength, relayLength };
+	const uint8_t* text[2] = { idText, listText };
+	uint16_t textLength[2];
+	uint16_t from = 0;
+	uint16_t to = 0;
+	uint8_t order[2] = { 0, 1 };
+
+	if( length > 0 && payload[0] == BINARY_VERSION )
+	{
+		idText[idLength++] = dest;
+		listText[listLength++] = size;
+		memcpy(listText + listLength, relayNodes + first, size);
+		listLength += size;
+	}
+	else
+	{
+		idLength = sprintf((char *)idText, "%u", dest);
+		listText[listLength++] = '[';
+		for(uint8_t i=0; i<size; i++)
+		{
+			listLength += sprintf((char *)listText + listLength, (i == 0) ? "%u" : ",%u", relayNodes[first + i]);
+		}
+		listText[listLength++] = ']';
+	}
+	textLength[0] = idLength;
+	textLength[1] = listLength;
+
+	if( start[1] < start[0] )
+	{
+		order[0] = 1;
+		order[1] = 0;
+	}
+
+	for(uint8_t i=0; i<2; i++)
+	{
+		uint8_t e = order[i];
+
+		// A field that was not sent is not patched
+		if( span[e] == 0 )
+		{
+			continue;
+		}
+		if( to + (start[e] - from) + textLength[e] > CMD_BUFFER_SIZE )
+		{
+			return 0;
+		}
+		memcpy(buffer + to, payload + from, start[e] - from);
+		to += start[e] - from;
+		memcpy(buffer + to, text[e], textLength[e]);
+		to += textLength[e];
+		from = start[e] + span[e];
+	}
+
+	if( to + (length - from) > CMD_BUFFER_SIZE )
+	{
+		return 0;
+	}
+	memcpy(buffer + to, payload + from, length - from);
+	to += length - from;
+
+	return to;
+}
+
 void Command::shiftRelayNodes()
 {
 	// Shift array one node to the left
@@ -300,6 +790,14 @@ void Command::dump()
 	Serial.println( fadeIncrement );
 	Serial.print(", number: ");
 	Serial.println( number );
+	Serial.print(", layer: ");
+	Serial.print( layer );
+	Serial.print(", blend: ");
+	Serial.print( blend );
+	Serial.print(", alpha: ");
+	Serial.print( alpha );
+	Serial.print(", transitionTime: ");
+	Serial.println( transitionTime );
 
 #endif
 }
@@ -345,12 +843,12 @@ void Command::setShow(uint8_t show)
 }
 
 
-uint8_t Command::getIndex() const
+uint16_t Command::getIndex() const
 {
 	return index;
 }
 
-void Command::setIndex(uint8_t index)
+void Command::setIndex(uint16_t index)
 {
 	this->index = index;
 }
@@ -556,6 +1054,162 @@ void Command::setNumber(uint8_t n)
 	this->number = n;
 }
 
+uint8_t Command::getLayer() const
+{
+	return layer;
+}
+
+void Command::setLayer(uint8_t layer)
+{
+	this->layer = layer;
+}
+
+uint8_t Command::getBlend() const
+{
+	return blend;
+}
+
+void Command::setBlend(uint8_t blend)
+{
+	this->blend = blend;
+}
+
+uint8_t Command::getAlpha() const
+{
+	return alpha;
+}
+
+void Command::setAlpha(uint8_t alpha)
+{
+	this->alpha = alpha;
+}
+
+uint32_t Command::getTransitionTime() const
+{
+	return transitionTime;
+}
+
+void Command::setTransitionTime(uint32_t transitionTime)
+{
+	this->transitionTime = transitionTime;
+}
+
+uint8_t Command::getPriority() const
+{
+	return priority;
+}
+
+void Command::setPriority(uint8_t priority)
+{
+	this->priority = priority;
+}
+
+uint8_t Command::getPreempt() const
+{
+	return preempt;
+}
+
+void Command::setPreempt(uint8_t preempt)
+{
+	this->preempt = preempt;
+}
+
+uint32_t Command::getExecuteAt() const
+{
+	return executeAt;
+}
+
+void Command::setExecuteAt(uint32_t executeAt)
+{
+	this->executeAt = executeAt;
+}
+
+/**
+ * Local time the command arrived (ms)
+ */
+uint32_t Command::getReceiveTime() const
+{
+	return receiveTime;
+}
+
+void Command::setReceiveTime(uint32_t receiveTime)
+{
+	this->receiveTime = receiveTime;
+}
+
+uint32_t Command::getSyncOrigin() const
+{
+	return syncOrigin;
+}
+
+void Command::setSyncOrigin(uint32_t syncOrigin)
+{
+	this->syncOrigin = syncOrigin;
+}
+
+uint32_t Command::getSyncTime() const
+{
+	return syncTime;
+}
+
+uint16_t Command::getBatchStart() const
+{
+	return batchStart;
+}
+
+uint16_t Command::getProgramStart() const
+{
+	return programStart;
+}
+
+uint16_t Command::getProgramLength() const
+{
+	return programLength;
+}
+
+uint16_t Command::getPresetStart() const
+{
+	return presetStart;
+}
+
+uint16_t Command::getPresetLength() const
+{
+	return presetLength;
+}
+
+uint8_t Command::getBatch() const
+{
+	return batch;
+}
+
+void Command::setBatch(uint8_t batch)
+{
+	this->batch = batch;
+}
+
+uint8_t Command::getAtomic() const
+{
+	return atomic;
+}
+
+void Command::setAtomic(uint8_t atomic)
+{
+	this->atomic = atomic;
+}
+
+void Command::setPowerReport(uint32_t peak, uint8_t scale)
+{
+	powerPeak = peak;
+	powerScale = scale;
+}
+
+void Command::setQueueReport(uint8_t depth, uint32_t dropped, uint32_t duplicates)
+{
+	queueDepth = depth;
+	queueDropped = dropped;
+	this->duplicates = duplicates;
+}
+
 uint8_t Command::getNotifyOnComplete() const
 {
 	return notifyOnComplete;
@@ -590,8 +1244,34 @@ void Command::setRelayNode(uint8_t index, uint8_t value)
 	}
 }
 
+void Command::setRelayNodes(uint8_t* nodes, uint8_t size)
+{
+	relayNodeSize = (size > MAX_RELAY_NODES) ? MAX_RELAY_NODES : size;
+	memmove(relayNodes, nodes, relayNodeSize);
+}
+
 uint8_t Command::getRelayNodeSize()
 {
 	return relayNodeSize;
 }
 
+uint8_t Command::getRelayFanout() const
+{
+	return relayFanout;
+}
+
+void Command::setRelayFanout(uint8_t relayFanout)
+{
+	this->relayFanout = relayFanout;
+}
+
+uint32_t Command::getRelayOffset() const
+{
+	return relayOffset;
+}
+
+void Command::setRelayOffset(uint32_t relayOffset)
+{
+	this->relayOffset = relayOffset;
+}
+
@@ -13,11 +13,67 @@
 
 #include "ClientGlobal.h"
 #include "Helper.h"
+#include "JsonReader.h"
 #include "NeopixelWrapper.h"
 
 #define CMD_BUFFER_SIZE		512
 #define MAX_RELAY_NODES		16
 
+// Binary commands start with the protocol version; JSON starts with '{'.
+//
+// Header (multi-byte values little endian):
+//   version(1) cmd(1) uid(4) nid(1) flags(1) fields(4)
+// followed by the values of the fields whose bit is set, in bit order,
+// each at the width given below.
+#define BINARY_VERSION			0x01
+#define BINARY_HEADER_SIZE		12
+
+// Plays a stored preset without parsing: PRESET_TRIGGER(1) id(1)
+#define PRESET_TRIGGER			0x02
+
+// Pixels streamed straight to the LEDs; see FrameStream
+#define FRAME_VERSION			0x03
+
+#define FLAG_NOTIFY_ON_COMPLETE	0x01
+#define FLAG_RELAY				0x02
+#define FLAG_SHOW				0x04
+#define FLAG_CLEAR_AFTER		0x08
+#define FLAG_CLEAR_END			0x10
+#define FLAG_PREEMPT			0x20
+#define FLAG_RELAY_ON_RECEIPT	0x40	// with FLAG_RELAY
+
+#define FIELD_FPS				0	// 1 byte
+#define FIELD_UPDATE_TIME		1	// 1
+#define FIELD_INTENSITY			2	// 1
+#define FIELD_INDEX				3	// 2
+#define FIELD_PATTERN			4	// 1
+#define FIELD_PATTERN_LENGTH	5	// 1
+#define FIELD_DURATION			6	// 4
+#define FIELD_REPEAT			7	// 2
+#define FIELD_DIRECTION			8	// 1
+#define FIELD_FADE_BY			9	// 1
+#define FIELD_PROBABILITY		10	// 1
+#define FIELD_ON_COLOR			11	// 3, RGB
+#define FIELD_OFF_COLOR			12	// 3, RGB
+#define FIELD_ON_TIME			13	// 4
+#define FIELD_OFF_TIME			14	// 4
+#define FIELD_BOUNCE_TIME		15	// 4
+#define FIELD_FADE_TIME			16	// 4
+#define FIELD_FADE_INCREMENT	17	// 1
+#define FIELD_NUMBER			18	// 1
+#define FIELD_LAYER				19	// 1
+#define FIELD_BLEND				20	// 1
+#define FIELD_ALPHA				21	// 1
+#define FIELD_TRANSITION_TIME	22	// 4
+#define FIELD_RELAY_NODES		23	// 1 count + count node ids
+#define FIELD_PRIORITY			24	// 1
+#define FIELD_EXECUTE_AT		25	// 4
+#define FIELD_RELAY_FANOUT		26	// 1
+#define FIELD_RELAY_OFFSET		27	// 4
+#define FIELD_PROGRAM			28	// 2 length + bytecode
+#define FIELD_PRESET			29	// 2 length + command message
+#define NUMBER_FIELDS			30
+
 // Defines JSON keys for command values
 #define	KEY_CMD						"cmd"
 #define KEY_NOTIFY_ON_COMPLETE		"noc"
@@ -48,6 +104,44 @@
 #define KEY_SHOW					"s"
 #define KEY_UNIQUE_ID				"uid"
 #define KEY_NUMBER					"n"
+#define KEY_LAYER					"ly"
+#define KEY_BLEND					"bl"
+#define KEY_ALPHA					"al"
+#define KEY_TRANSITION_TIME			"tt"
+#define KEY_POWER_PEAK				"pwr"
+#define KEY_POWER_SCALE				"psc"
+#define KEY_PRIORITY				"pri"
+#define KEY_PREEMPT					"pre"
+#define KEY_QUEUE_DEPTH				"qd"
+#define KEY_QUEUE_DROPPED			"qdr"
+#define KEY_BATCH					"b"
+#define KEY_ATOMIC					"atm"
+#define KEY_EXECUTE_AT				"at"
+#define KEY_SYNC_ORIGIN				"t0"
+#define KEY_SYNC_TIME				"ts"
+#define KEY_RELAY_FANOUT			"rk"
+#define KEY_RELAY_OFFSET			"ro"
+#define KEY_DUPLICATES				"dup"
+#define KEY_PROGRAM					"prg"
+#define KEY_PRESET					"pst"
+#define KEY_METRICS_TIME			"mt"
+#define KEY_METRICS_PARSE			"pa"
+#define KEY_METRICS_PARSE_MAX		"pam"
+#define KEY_METRICS_WAIT			"qw"
+#define KEY_METRICS_WAIT_MAX		"qwm"
+#define KEY_METRICS_LOOP			"lp"
+#define KEY_METRICS_LOOP_MAX		"lpm"
+#define KEY_METRICS_SHOW			"sh"
+#define KEY_METRICS_SHOW_MAX		"shm"
+#define KEY_METRICS_FRAMES			"fr"
+#define KEY_METRICS_SKIPPED			"fs"
+#define KEY_METRICS_FPS				"afps"
+#define KEY_METRICS_LATENESS		"lt"
+#define KEY_METRICS_RECONNECTS		"rc"
+#define KEY_METRICS_WIFI_LOST		"wl"
+#define KEY_METRICS_WIFI_TIME		"wct"
+#define KEY_METRICS_HEAP			"hp"
+#define KEY_METRICS_BLOCK			"hb"
 
 
 // Basic Functions
@@ -55,6 +149,7 @@
 #define CMD_FILL_PATTERN        0x02	// Fills strip with specified pattern
 #define CMD_SET_PIXEL			0x03	// Sets specific pixel specified color
 #define CMD_SHOW				0x04	// Shows pixels
+#define CMD_CLEAR_LAYER			0x05	// Turns off an overlay layer
 
 // Basic Animations
 #define CMD_PATTERN 			0x11	// Fills with pattern and rotates pattern
@@ -77,15 +172,32 @@
 #define CMD_CYLON               0x23
 #define CMD_BPM                 0x24
 #define CMD_JUGGLE              0x25
+#define CMD_RUN_PROGRAM         0x26	// Runs the loaded bytecode program
 
 // Administrative Functions
 #define CMD_SET_INTENSITY		0x32
+#define CMD_SYNC				0x33	// Clock sync ping and reply
+#define CMD_LOAD_PROGRAM		0x34	// Stores a bytecode program
+#define CMD_STORE_PRESET		0x35	// Stores a message as preset n
+#define CMD_PLAY_PRESET			0x36	// Handles preset n as if it just arrived
+#define CMD_SET_METRICS			0x37	// Publishes metrics every d ms; 0 stops them
 
 
 // Other "commands"
+#define CMD_METRICS				0x5D	// Metrics snapshot
 #define CMD_COMPLETE			0x5E
 #define CMD_ERROR               0x5F
 
+// When a command is relayed to the nodes in its relay list
+#define RELAY_NONE				0
+#define RELAY_ON_COMPLETE		1	// after it completes here
+#define RELAY_ON_RECEIPT		2	// as it arrives, or relay offset ms later
+
+// Position of a command in a batch message
+#define BATCH_NONE				0
+#define BATCH_MEMBER			1	// more commands of the batch follow
+#define BATCH_LAST				2
+
 // Error codes
 #define STATUS_SUCCESS			0x01
 #define STATUS_ERROR			0x10
@@ -98,9 +210,11 @@ public:
 
 	// Functions
 	void initialize();
-	uint8_t parse(uint8_t *b);
+	uint8_t parse(uint8_t *b, uint16_t length);
+	static uint32_t peekUniqueId(const uint8_t *b, uint16_t length);
 	uint8_t buildCommand(uint8_t *b);
 	uint8_t buildResponse(uint8_t *b);
+	uint8_t buildSync(uint8_t *b);
 	void dump();
 
 	// Getters and Setters
@@ -113,8 +227,8 @@ public:
 	uint8_t getNodeId() const;
 	void setNodeId(uint8_t nodeId);
 
-	uint8_t getIndex() const;
-	void setIndex(uint8_t index);
+	uint16_t getIndex() const;
+	void setIndex(uint16_t index);
 
 	uint8_t getShow() const;
 	void setShow(uint8_t show);
@@ -164,9 +278,18 @@ public:
 
 	uint8_t *getRelayNodes();
 	void setRelayNode(uint8_t index, uint8_t value);
+	void setRelayNodes(uint8_t* nodes, uint8_t size);
 	uint8_t getRelayNodeSize();
 	void shiftRelayNodes();
 
+	uint8_t getRelayFanout() const;
+	void setRelayFanout(uint8_t relayFanout);
+	uint32_t getRelayOffset() const;
+	void setRelayOffset(uint32_t relayOffset);
+
+	uint8_t getRelayChild(uint8_t child, uint8_t* dest, uint8_t* first, uint8_t* size);
+	uint16_t buildRelay(const uint8_t* payload, uint16_t length, uint8_t dest, uint8_t first, uint8_t size, uint8_t* b);
+
 	uint8_t getIntensity() const;
 	void setIntensity(uint8_t i);
 
@@ -179,7 +302,52 @@ public:
 	uint8_t getNumber() const;
 	void setNumber(uint8_t updateTime);
 
+	uint8_t getLayer() const;
+	void setLayer(uint8_t layer);
+
+	uint8_t getBlend() const;
+	void setBlend(uint8_t blend);
+
+	uint8_t getAlpha() const;
+	void setAlpha(uint8_t alpha);
+
+	uint32_t getTransitionTime() const;
+	void setTransitionTime(uint32_t transitionTime);
+
+	uint8_t getPriority() const;
+	void setPriority(uint8_t priority);
+
+	uint8_t getPreempt() const;
+	void setPreempt(uint8_t preempt);
+
+	uint32_t getExecuteAt() const;
+	void setExecuteAt(uint32_t executeAt);
+
+	uint32_t getReceiveTime() const;
+	void setReceiveTime(uint32_t receiveTime);
+
+	uint32_t getSyncOrigin() const;
+	void setSyncOrigin(uint32_t syncOrigin);
+	uint32_t getSyncTime() const;
+
+	uint16_t getBatchStart() const;
+	uint16_t getProgramStart() const;
+	uint16_t getProgramLength() const;
+	uint16_t getPresetStart() const;
+	uint16_t getPresetLength() const;
+	uint8_t getBatch() const;
+	void setBatch(uint8_t batch);
+	uint8_t getAtomic() const;
+	void setAtomic(uint8_t atomic);
+
+	void setPowerReport(uint32_t peak, uint8_t scale);
+	void setQueueReport(uint8_t depth, uint32_t dropped, uint32_t duplicates);
+
 private:
+	uint8_t parseJson(const uint8_t *b, uint16_t length);
+	uint8_t parseBinary(uint8_t *b, uint16_t length);
+	void clearFields();
+
 	uint8_t command;
 	uint32_t uniqueId;
 	uint8_t nodeId;
@@ -188,14 +356,31 @@ private:
 	uint8_t relay;
 	uint8_t relayNodes[MAX_RELAY_NODES];
 	uint8_t relayNodeSize;
+	uint8_t relayFanout;
+	uint32_t relayOffset;
+
+	// Where the node id and relay list sit in the received payload
+	uint16_t nodeIdStart;
+	uint16_t nodeIdLength;
+	uint16_t relayStart;
+	uint16_t relayLength;
 
 	uint8_t show;
+	uint8_t preempt;
+	uint8_t priority;
+	uint8_t batch;
+	uint8_t atomic;
+	uint16_t batchStart;
+	uint16_t programStart;
+	uint16_t programLength;
+	uint16_t presetStart;
+	uint16_t presetLength;
 
 	uint8_t framesPerSecond;
 	uint8_t hueUpdateTime;
 	uint8_t intensity;
 
-	uint8_t index;
+	uint16_t index;
 	uint8_t pattern;
 	uint8_t patternLength;
 	uint32_t duration;
@@ -213,6 +398,21 @@ private:
 	uint32_t fadeTime;
 	uint8_t fadeIncrement;
 	uint8_t number;
+	uint8_t layer;
+	uint8_t blend;
+	uint8_t alpha;
+	uint32_t transitionTime;
+	uint32_t executeAt;
+	uint32_t receiveTime;
+	uint32_t syncOrigin;
+	uint32_t syncTime;
+
+	// Reported back on completion
+	uint32_t powerPeak;
+	uint8_t powerScale;
+	uint8_t queueDepth;
+	uint32_t queueDropped;
+	uint32_t duplicates;
 
 };
 
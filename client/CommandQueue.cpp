@@ -0,0 +1,235 @@
+/*
+ * CommandQueue.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#include "CommandQueue.h"
+
+/**
+ * Constructor
+ */
+CommandQueue::CommandQueue()
+{
+	head = 0;
+	count = 0;
+	maxDepth = 0;
+	dropped = 0;
+	clock = 0;
+}
+
+/**
+ * Sets the clock execute times are compared against
+ */
+void CommandQueue::setClock(ClockSync* clock)
+{
+	this->clock = clock;
+}
+
+/**
+ * Returns the slot the next command is parsed into.  The command only
+ * joins the queue on commit(), so a failed parse leaves the queue as is.
+ *
+ */
+Command* CommandQueue::reserve()
+{
+	Command* cmd = &incoming;
+
+	if( count < COMMAND_QUEUE_SIZE )
+	{
+		cmd = at(count);
+	}
+	cmd->initialize();
+
+	return cmd;
+}
+
+/**
+ * Adds the reserved command to the queue
+ */
+void CommandQueue::commit()
+{
+	uint8_t victim = COMMAND_QUEUE_SIZE;
+
+	if( count < COMMAND_QUEUE_SIZE )
+	{
+		count += 1;
+	}
+	else
+	{
+		// Full; make room by dropping the newest lower priority command
+		for(uint8_t i=0; i<count; i++)
+		{
+			if( at(i)->getPriority() < incoming.getPriority()
+					&& (victim == COMMAND_QUEUE_SIZE || at(i)->getPriority() <= at(victim)->getPriority()) )
+			{
+				victim = i;
+			}
+		}
+
+		dropped += 1;
+		if( victim == COMMAND_QUEUE_SIZE )
+		{
+			Serial.println(F("ERROR - command queue full; command dropped"));
+			return;
+		}
+		Serial.println(F("ERROR - command queue full; lower priority command dropped"));
+		remove(victim);
+		*at(count) = incoming;
+		count += 1;
+	}
+
+	if( count > maxDepth )
+	{
+		maxDepth = count;
+	}
+}
+
+/**
+ * Returns true if n commands fit in the queue; otherwise the batch
+ * is counted as dropped.
+ *
+ */
+uint8_t CommandQueue::reserveBatch(uint8_t n)
+{
+	if( n > COMMAND_QUEUE_SIZE - count )
+	{
+		dropped += 1;
+		Serial.println(F("ERROR - command queue full; batch dropped"));
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Returns the command that runs next without removing it; NULL if no
+ * command is ready
+ */
+Command* CommandQueue::peek()
+{
+	uint8_t i = next();
+
+	if( i == COMMAND_QUEUE_SIZE )
+	{
+		return 0;
+	}
+	return at(i);
+}
+
+/**
+ * Copies the next command out and removes it.  Returns false if no
+ * command is ready.
+ *
+ */
+uint8_t CommandQueue::pop(Command* cmd)
+{
+	uint8_t i = next();
+
+	if( i == COMMAND_QUEUE_SIZE )
+	{
+		return false;
+	}
+
+	*cmd = *at(i);
+	remove(i);
+
+	return true;
+}
+
+/**
+ * Returns true if no command is waiting
+ */
+uint8_t CommandQueue::isEmpty()
+{
+	return (count == 0);
+}
+
+/**
+ * Returns the number of commands waiting
+ */
+uint8_t CommandQueue::getDepth()
+{
+	return count;
+}
+
+/**
+ * Returns the most commands that were waiting at once
+ */
+uint8_t CommandQueue::getMaxDepth()
+{
+	return maxDepth;
+}
+
+/**
+ * Returns the number of commands dropped because the queue was full
+ */
+uint32_t CommandQueue::getDropped()
+{
+	return dropped;
+}
+
+/**
+ * Prints the queue statistics
+ */
+void CommandQueue::dump()
+{
+	Serial.print(F("Queue - depth: "));
+	Serial.print( count );
+	Serial.print(F(", max depth: "));
+	Serial.print( maxDepth );
+	Serial.print(F(", dropped: "));
+	Serial.println( dropped );
+}
+
+/**
+ * Returns the i-th waiting command, oldest first
+ */
+Command* CommandQueue::at(uint8_t i)
+{
+	return &entries[ (head + i) % COMMAND_QUEUE_SIZE ];
+}
+
+/**
+ * Returns the position of the oldest ready command with the highest
+ * priority; COMMAND_QUEUE_SIZE if none is ready
+ */
+uint8_t CommandQueue::next()
+{
+	uint8_t best = COMMAND_QUEUE_SIZE;
+	Command* cmd;
+
+	for(uint8_t i=0; i<count; i++)
+	{
+		cmd = at(i);
+		if( cmd->getExecuteAt() != 0 && clock != 0 && !clock->isDue( cmd->getExecuteAt() ) )
+		{
+			continue;
+		}
+		if( best == COMMAND_QUEUE_SIZE || cmd->getPriority() > at(best)->getPriority() )
+		{
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+/**
+ * Removes the i-th waiting command, keeping the others in order
+ */
+void CommandQueue::remove(uint8_t i)
+{
+	if( i == 0 )
+	{
+		head = (head + 1) % COMMAND_QUEUE_SIZE;
+	}
+	else
+	{
+		for(; i<count-1; i++)
+		{
+			*at(i) = *at(i+1);
+		}
+	}
+	count -= 1;
+}
@@ -0,0 +1,64 @@
+/*
+ * CommandQueue.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#ifndef COMMANDQUEUE_H_
+#define COMMANDQUEUE_H_
+
+#include <Arduino.h>
+
+#include "ClientGlobal.h"
+#include "ClockSync.h"
+#include "Command.h"
+
+// Commands held between the MQTT callback and the executor
+#define COMMAND_QUEUE_SIZE		8
+
+/**
+ * Fixed size queue of parsed commands.
+ *
+ * The MQTT callback parses each message straight into a free slot, so a
+ * burst of messages no longer overwrites the one waiting to run.  Commands
+ * leave highest priority first and in arrival order within a priority.
+ * When the queue is full a new command replaces the newest command of
+ * lower priority, otherwise it is dropped; drops are counted.  A batch
+ * is queued whole or not at all.  Commands with an execute time wait
+ * until the shared clock reaches it; the others pass them by.
+ */
+class CommandQueue
+{
+public:
+	CommandQueue();
+	void setClock(ClockSync* clock);
+
+	Command* reserve();
+	void commit();
+	uint8_t reserveBatch(uint8_t n);
+
+	Command* peek();
+	uint8_t pop(Command* cmd);
+
+	uint8_t isEmpty();
+	uint8_t getDepth();
+	uint8_t getMaxDepth();
+	uint32_t getDropped();
+	void dump();
+
+protected:
+	Command entries[COMMAND_QUEUE_SIZE];
+	Command incoming;
+	uint8_t head;
+	uint8_t count;
+	uint8_t maxDepth;
+	uint32_t dropped;
+	ClockSync* clock;
+
+	Command* at(uint8_t i);
+	uint8_t next();
+	void remove(uint8_t i);
+};
+
+#endif /* COMMANDQUEUE_H_ */
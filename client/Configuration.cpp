@@ -24,7 +24,7 @@ uint8_t Configuration::initialize()
 {
 	uint8_t flag = false;
 
-	EEPROM.begin(FLASH_SIZE);
+	EEPROM.begin(EEPROM_SIZE);
 
 	Serial.print(F("Reading client configuration...."));
 	flag = read();
@@ -85,12 +85,12 @@ void Configuration::setNodeId(uint8_t nodeId)
 	sprintf((char *)myResponseChannel, DEFAULT_CHANNEL_RESP, nodeId );
 }
 
-uint8_t Configuration::getNumberLeds()
+uint16_t Configuration::getNumberLeds()
 {
 	return numberLeds;
 }
 
-void Configuration::setNumberLeds(uint8_t numberLeds)
+void Configuration::setNumberLeds(uint16_t numberLeds)
 {
 	this->numberLeds = numberLeds;
 }
@@ -208,6 +208,16 @@ void Configuration::setMqttTries(uint8_t tries)
 	this->mqttTries = tries;
 }
 
+uint16_t Configuration::getPowerBudget() const
+{
+	return powerBudget;
+}
+
+void Configuration::setPowerBudget(uint16_t budget)
+{
+	this->powerBudget = budget;
+}
+
 
 void Configuration::dump()
 {
@@ -222,6 +232,8 @@ void Configuration::dump()
 	Serial.println(wifiTries);
 	Serial.print(F("MQTT Tries      : "));
 	Serial.println(mqttTries);
+	Serial.print(F("Power Budget mA : "));
+	Serial.println(powerBudget);
 
 	Serial.print(F("SSID            : "));
 	printBlock( ssid, STRING_SIZE );
@@ -254,9 +266,12 @@ uint8_t Configuration::read()
 
 	version = EEPROM.read(address++);
 	nodeId = EEPROM.read(address++);;
-	numberLeds = EEPROM.read(address++);;
+	numberLeds = EEPROM.read(address++) << 8;
+	numberLeds |= EEPROM.read(address++);
 	wifiTries = EEPROM.read(address++);;
 	mqttTries = EEPROM.read(address++);;
+	powerBudget = EEPROM.read(address++) << 8;
+	powerBudget |= EEPROM.read(address++);
 
 	readBlock( ssid, (uint8_t *)address, STRING_SIZE );
 	address += STRING_SIZE;
@@ -302,9 +317,12 @@ uint8_t Configuration::write()
 
 	EEPROM.write(address++, version);
 	EEPROM.write(address++, nodeId);
-	EEPROM.write(address++, numberLeds);
+	EEPROM.write(address++, (numberLeds >> 8) & 0xFF);
+	EEPROM.write(address++, numberLeds & 0xFF);
 	EEPROM.write(address++, wifiTries);
 	EEPROM.write(address++, mqttTries);
+	EEPROM.write(address++, (powerBudget >> 8) & 0xFF);
+	EEPROM.write(address++, powerBudget & 0xFF);
 	writeBlock( (uint8_t *)address, ssid, STRING_SIZE );
 	address += STRING_SIZE;
 	writeBlock( (uint8_t *)address, password, STRING_SIZE );
@@ -372,6 +390,7 @@ void Configuration::initializeVariables()
 	numberLeds = DEFAULT_NUMBER_LEDS;
 	wifiTries = DEFAULT_WIFI_TRIES;
 	mqttTries = DEFAULT_MQTT_TRIES;
+	powerBudget = DEFAULT_POWER_BUDGET;
 
 	memset(ssid, 0, STRING_SIZE);
 //	strcpy( (char *)ssid, defaultSsid);
@@ -409,7 +428,7 @@ void Configuration::initializeVariables()
  * CRC-8 - based on the CRC8 formulas by Dallas/Maxim
  * code released under the terms of the GNU GPL 3.0 license
  */
-uint8_t Configuration::computeChecksum(uint8_t *data, uint8_t len)
+uint8_t Configuration::computeChecksum(const uint8_t *data, uint16_t len)
 {
 	uint8_t crc = 0x00;
 	while (len--)
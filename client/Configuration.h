@@ -25,11 +25,13 @@
 #define CONFIG_V2				0x02
 #define CONFIG_V3				0x03
 
-#define DEFAULT_VERSION			CONFIG_V1
+#define DEFAULT_VERSION			CONFIG_V3
 #define DEFAULT_NODE_ID			1
 
 #define DEFAULT_NUMBER_NODES	0x06
 #define DEFAULT_NUMBER_LEDS		10
+#define MAX_NUMBER_LEDS			4096
+#define DEFAULT_POWER_BUDGET	0		// mA; 0 = no limit
 
 #define DEFAULT_WIFI_TRIES		20
 #define DEFAULT_MQTT_TRIES		20
@@ -45,7 +47,13 @@
 
 #define STRING_SIZE				20
 #define FLASH_SIZE				150
-#define CRC_SIZE				145
+#define CRC_SIZE				148
+
+// Presets are stored in fixed slots after the configuration
+#define PRESET_START_ADDRESS	FLASH_SIZE
+#define PRESET_SLOTS			8
+#define PRESET_SLOT_SIZE		384
+#define EEPROM_SIZE				(PRESET_START_ADDRESS + PRESET_SLOTS*PRESET_SLOT_SIZE)
 
 // TODO - add mqtt port to configuration
 // TODO - add mqtt username and password to configuration
@@ -63,8 +71,8 @@ public:
 	uint8_t getNodeId();
 	void setNodeId(uint8_t v);
 
-	uint8_t getNumberLeds();
-	void setNumberLeds(uint8_t v);
+	uint16_t getNumberLeds();
+	void setNumberLeds(uint16_t v);
 
 	uint8_t getWifiTries() const;
 	void setWifiTries(uint8_t wifiTries);
@@ -72,6 +80,9 @@ public:
 	uint8_t getMqttTries() const;
 	void setMqttTries(uint8_t tries);
 
+	uint16_t getPowerBudget() const;
+	void setPowerBudget(uint16_t budget);
+
 	const uint8_t* getAllChannel() const;
 	void setAllChannel(uint8_t *b);
 
@@ -100,14 +111,16 @@ public:
 	uint8_t read();
 	void dump();
 
+	static uint8_t computeChecksum(const uint8_t *data, uint16_t len);
+
 protected:
-	uint8_t computeChecksum(uint8_t *data, uint8_t len);
 
 	uint8_t version;
 	uint8_t nodeId;
-	uint8_t numberLeds;
+	uint16_t numberLeds;
 	uint8_t wifiTries;
 	uint8_t mqttTries;
+	uint16_t powerBudget;
 	uint8_t ssid[STRING_SIZE];
 	uint8_t password[STRING_SIZE];
 	uint8_t serverAddress[STRING_SIZE];
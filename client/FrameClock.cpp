@@ -0,0 +1,197 @@
+/*
+ * FrameClock.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#include "FrameClock.h"
+
+/**
+ * Constructor
+ */
+FrameClock::FrameClock()
+{
+	start(0);
+}
+
+/**
+ * Resets the clock and the statistics; the first frame is due now
+ */
+void FrameClock::start(uint32_t now)
+{
+	deadline = now;
+	interval = 0;
+	startTime = now;
+	lastFrame = now;
+
+	frames = 0;
+	overruns = 0;
+	maxLateness = 0;
+	lateness = 0;
+	totalLateness = 0;
+	scheduledTime = 0;
+}
+
+/**
+ * Schedules the next frame interval after the current deadline.
+ *
+ * If the frame just rendered overran its slot, the clock is re-anchored
+ * to now rather than bursting frames to catch up.  A zero interval also
+ * starts from now, so a deadline left behind while the clock was idle or
+ * running flat out is never caught up on.
+ *
+ */
+void FrameClock::schedule(uint32_t now, uint32_t interval)
+{
+	if( interval > FRAME_MAX_INTERVAL )
+	{
+		interval = FRAME_MAX_INTERVAL;
+	}
+
+	if( interval == 0 )
+	{
+		deadline = now;
+	}
+	else if( (int32_t)(now - deadline) > (int32_t)interval )
+	{
+		overruns += 1;
+		deadline = now;
+	}
+
+	this->interval = interval;
+	deadline += interval;
+	scheduledTime += interval;
+}
+
+/**
+ * Records a frame rendered at the specified time
+ */
+void FrameClock::tick(uint32_t now)
+{
+	lateness = 0;
+
+	if( (int32_t)(now - deadline) > 0 )
+	{
+		lateness = now - deadline;
+	}
+
+	frames += 1;
+	totalLateness += lateness;
+	if( lateness > maxLateness )
+	{
+		maxLateness = lateness;
+	}
+	lastFrame = now;
+}
+
+/**
+ * Returns true if the deadline has been reached
+ */
+uint8_t FrameClock::isDue(uint32_t now)
+{
+	return ( (int32_t)(now - deadline) >= 0 );
+}
+
+/**
+ * Returns the time remaining until the deadline; 0 if due
+ */
+uint32_t FrameClock::timeUntil(uint32_t now)
+{
+	if( isDue(now) )
+	{
+		return 0;
+	}
+	return deadline - now;
+}
+
+/**
+ * Sleeps until the deadline, but no longer than maxWait.  delay()
+ * yields to the ESP; the sub-millisecond remainder is spun.
+ *
+ */
+void FrameClock::sleep(uint32_t maxWait)
+{
+	uint32_t remaining = timeUntil( micros() );
+
+	if( remaining > maxWait )
+	{
+		remaining = maxWait;
+	}
+
+	if( remaining >= 1000 )
+	{
+		delay( remaining / 1000 );
+	}
+	else if( remaining > 0 )
+	{
+		delayMicroseconds( remaining );
+	}
+}
+
+uint32_t FrameClock::getFrames()
+{
+	return frames;
+}
+
+uint32_t FrameClock::getOverruns()
+{
+	return overruns;
+}
+
+uint32_t FrameClock::getMaxLateness()
+{
+	return maxLateness;
+}
+
+/**
+ * Returns how late the last frame was
+ */
+uint32_t FrameClock::getLateness()
+{
+	return lateness;
+}
+
+uint32_t FrameClock::getAverageLateness()
+{
+	if( frames == 0 )
+	{
+		return 0;
+	}
+	return totalLateness / frames;
+}
+
+/**
+ * Returns the sum of the intervals the animation asked for
+ */
+uint32_t FrameClock::getScheduledTime()
+{
+	return scheduledTime;
+}
+
+/**
+ * Returns the time between the first and the last frame
+ */
+uint32_t FrameClock::getElapsedTime()
+{
+	return lastFrame - startTime;
+}
+
+/**
+ * Prints the frame statistics
+ */
+void FrameClock::dump()
+{
+	Serial.print(F("Frames: "));
+	Serial.print(frames);
+	Serial.print(F(", scheduled(us): "));
+	Serial.print(scheduledTime);
+	Serial.print(F(", actual(us): "));
+	Serial.print(getElapsedTime());
+	Serial.print(F(", max late(us): "));
+	Serial.print(maxLateness);
+	Serial.print(F(", avg late(us): "));
+	Serial.print(getAverageLateness());
+	Serial.print(F(", overruns: "));
+	Serial.println(overruns);
+}
@@ -0,0 +1,70 @@
+/*
+ * FrameClock.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#ifndef FRAMECLOCK_H_
+#define FRAMECLOCK_H_
+
+#include <Arduino.h>
+
+#include "ClientGlobal.h"
+
+// Longest time we sleep before servicing the network again (us)
+#define FRAME_SERVICE_INTERVAL	1000
+
+// Longest frame interval we schedule; keeps deadlines inside the
+// rollover-safe window of micros() (us)
+#define FRAME_MAX_INTERVAL		1800000000UL
+
+/**
+ * Monotonic frame clock.
+ *
+ * Frames are scheduled against absolute deadlines in microseconds, so the
+ * time spent rendering and servicing the network does not accumulate as
+ * drift.  All comparisons are done on the signed difference, which makes
+ * the clock safe across micros() rollover.
+ *
+ * Keeps statistics for the current command: frames rendered, scheduled
+ * vs. actual time, lateness and overruns (frames that missed their slot
+ * by more than a full frame interval).
+ */
+class FrameClock
+{
+public:
+	FrameClock();
+
+	void start(uint32_t now);
+	void schedule(uint32_t now, uint32_t interval);
+	void tick(uint32_t now);
+
+	uint8_t isDue(uint32_t now);
+	uint32_t timeUntil(uint32_t now);
+	void sleep(uint32_t maxWait);
+
+	uint32_t getFrames();
+	uint32_t getOverruns();
+	uint32_t getMaxLateness();
+	uint32_t getLateness();
+	uint32_t getAverageLateness();
+	uint32_t getScheduledTime();
+	uint32_t getElapsedTime();
+	void dump();
+
+protected:
+	uint32_t deadline;
+	uint32_t interval;
+	uint32_t startTime;
+	uint32_t lastFrame;
+
+	uint32_t frames;
+	uint32_t overruns;
+	uint32_t maxLateness;
+	uint32_t lateness;
+	uint32_t totalLateness;
+	uint32_t scheduledTime;
+};
+
+#endif /* FRAMECLOCK_H_ */
@@ -0,0 +1,138 @@
+/*
+ * FrameStream.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#include "FrameStream.h"
+
+/**
+ * Constructor
+ */
+FrameStream::FrameStream()
+{
+	controller = 0;
+	sequence = 0;
+	active = false;
+	firstTime = 0;
+	lastTime = 0;
+	frames = 0;
+	stale = 0;
+}
+
+/**
+ * Sets the LEDs frames are drawn on; frames are dropped until it is set
+ */
+void FrameStream::setController(NeopixelWrapper* controller)
+{
+	this->controller = controller;
+}
+
+/**
+ * Draws a streamed message.  Returns false if it was stale or malformed.
+ *
+ */
+uint8_t FrameStream::receive(const uint8_t* payload, uint16_t length, uint32_t now)
+{
+	uint16_t seq;
+	uint16_t start;
+
+	if( controller == 0 || length < FRAME_HEADER_SIZE || (length - FRAME_HEADER_SIZE) % 3 != 0 ||
+		(length - FRAME_HEADER_SIZE) / 3 > FRAME_MAX_PIXELS )
+	{
+		Serial.println(F("ERROR - bad frame"));
+		return false;
+	}
+
+	seq = payload[2] | (payload[3] << 8);
+	start = payload[4] | (payload[5] << 8);
+
+	// Ranges of the current frame share its number; older frames are stale
+	if( active && (now - lastTime) < FRAME_STREAM_TIMEOUT && (int16_t)(seq - sequence) < 0 )
+	{
+		stale += 1;
+		return false;
+	}
+
+	if( !active || (now - lastTime) >= FRAME_STREAM_TIMEOUT )
+	{
+		Serial.println(F("Stream started"));
+		active = true;
+		firstTime = now;
+		frames = 0;
+		stale = 0;
+	}
+	sequence = seq;
+	lastTime = now;
+
+	controller->setPixels(start, payload + FRAME_HEADER_SIZE, (length - FRAME_HEADER_SIZE) / 3,
+			(payload[1] & FRAME_FLAG_SHOW) ? true : false);
+	if( payload[1] & FRAME_FLAG_SHOW )
+	{
+		frames += 1;
+	}
+
+	return true;
+}
+
+/**
+ * Reports the throughput once the stream went silent
+ */
+void FrameStream::work(uint32_t now)
+{
+	if( active && (now - lastTime) >= FRAME_STREAM_TIMEOUT )
+	{
+		active = false;
+		dump();
+	}
+}
+
+/**
+ * Returns true while the controller is streaming
+ */
+uint8_t FrameStream::isActive()
+{
+	return active;
+}
+
+/**
+ * Returns the frames shown since the stream started
+ */
+uint32_t FrameStream::getFrames()
+{
+	return frames;
+}
+
+/**
+ * Returns the stale ranges dropped since the stream started
+ */
+uint32_t FrameStream::getStale()
+{
+	return stale;
+}
+
+/**
+ * Returns the rate frames were shown at since the stream started
+ */
+uint32_t FrameStream::getFramesPerSecond()
+{
+	uint32_t elapsed = lastTime - firstTime;
+
+	return (elapsed > 0 && frames > 1) ? (frames - 1) * 1000 / elapsed : 0;
+}
+
+/**
+ * Prints the stream throughput
+ */
+void FrameStream::dump()
+{
+	Serial.print(F("Stream - frames: "));
+	Serial.print( frames );
+	Serial.print(F(", stale: "));
+	Serial.print( stale );
+	Serial.print(F(", fps: "));
+	Serial.print( getFramesPerSecond() );
+	Serial.print(F(", leds: "));
+	Serial.println( controller ? controller->size() : 0 );
+}
@@ -0,0 +1,68 @@
+/*
+ * FrameStream.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#ifndef FRAMESTREAM_H_
+#define FRAMESTREAM_H_
+
+#include <Arduino.h>
+
+#include "ClientGlobal.h"
+#include "Command.h"
+#include "NeopixelWrapper.h"
+
+// Header (multi-byte values little endian):
+//   version(1) flags(1) sequence(2) start(2)
+// followed by R, G, B of each pixel from start to the end of the message.
+#define FRAME_HEADER_SIZE		6
+
+// Most pixels one message may carry, so it fits the command buffer the
+// MQTT packet is sized for; longer frames are sent as several ranges
+#define FRAME_MAX_PIXELS		((CMD_BUFFER_SIZE - FRAME_HEADER_SIZE) / 3)
+
+#define FRAME_FLAG_SHOW			0x01	// last range of the frame; show it
+
+// A stream silent this long has ended; the next one may start at any
+// sequence number (ms)
+#define FRAME_STREAM_TIMEOUT	2000
+
+/**
+ * Takes frames rendered by the controller and copies them straight into
+ * the LEDs, without parsing or queueing.  A message carries the whole
+ * frame or a range of up to FRAME_MAX_PIXELS of it (168 pixels); every
+ * range of a frame has the frame's sequence number and the last one is
+ * flagged to show the frame.
+ *
+ * Frames older than the newest one seen arrive too late to be worth
+ * drawing and are dropped.  The frame rate shown is reported when the
+ * stream ends, to measure throughput per node.  Frames are drawn on the
+ * base layer; a running animation is stopped while the stream is active.
+ */
+class FrameStream
+{
+public:
+	FrameStream();
+	void setController(NeopixelWrapper* controller);
+
+	uint8_t receive(const uint8_t* payload, uint16_t length, uint32_t now);
+	void work(uint32_t now);
+	uint8_t isActive();
+	uint32_t getFrames();
+	uint32_t getStale();
+	uint32_t getFramesPerSecond();
+	void dump();
+
+protected:
+	NeopixelWrapper* controller;
+	uint16_t sequence;
+	uint8_t active;
+	uint32_t firstTime;
+	uint32_t lastTime;
+	uint32_t frames;
+	uint32_t stale;
+};
+
+#endif /* FRAMESTREAM_H_ */
@@ -27,8 +27,10 @@ void Helper::workYield()
  */
 void Helper::delayYield(uint32_t time)
 {
+	uint32_t deadline = millis() + time;
+
 	if( time == 0 ) return;
-	for (uint32_t i = 0; i < time; i++)
+	while( (int32_t)(millis() - deadline) < 0 )
 	{
 		delay(1);
 		yield(); // give time to ESP
@@ -43,8 +45,10 @@ void Helper::delayYield(uint32_t time)
  */
 void Helper::delayWorker(uint32_t time)
 {
+	uint32_t deadline = millis() + time;
+
 	if( time == 0 ) return;
-	for (uint32_t i = 0; i < time; i++)
+	while( (int32_t)(millis() - deadline) < 0 )
 	{
 		delay(1);
 		worker(); // this calls pubsub.loop, which might crash if queue is not properly initialized
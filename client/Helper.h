@@ -49,8 +49,6 @@ extern "C"
 #endif
 
 extern void worker();
-extern uint8_t isCommandAvailable();
-extern uint8_t commandDelay(uint32_t time);
 extern void setStatus(volatile StatusEnum status);
 extern volatile StatusEnum getStatus();
 extern void yield();
@@ -0,0 +1,342 @@
+/*
+ * JsonReader.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#include "JsonReader.h"
+
+/**
+ * Constructor; the text must hold one object, one array if opened with
+ * '[' or a single value if opened with 0
+ */
+JsonReader::JsonReader(const uint8_t* b, uint16_t length, uint8_t open)
+{
+	begin = b;
+	p = b;
+	end = b + length;
+	key = 0;
+	keyLength = 0;
+	keyHash = JSON_HASH_SEED;
+	valid = true;
+	first = true;
+
+	skipSpace();
+	if( open != 0 && !expect(open) )
+	{
+		fail();
+	}
+}
+
+/**
+ * Moves to the next key, hashing it on the way.  Returns false at the end
+ * of the object or on bad text; check isValid() to tell them apart.
+ *
+ */
+uint8_t JsonReader::nextKey()
+{
+	if( !valid )
+	{
+		return false;
+	}
+
+	skipSpace();
+	if( expect('}') )
+	{
+		p = end;
+		return false;
+	}
+	if( !first && !expect(',') )
+	{
+		fail();
+		return false;
+	}
+	first = false;
+
+	skipSpace();
+	if( !expect('"') )
+	{
+		fail();
+		return false;
+	}
+
+	key = p;
+	keyHash = JSON_HASH_SEED;
+	while( p < end && *p != '"' )
+	{
+		keyHash = (keyHash ^ *p) * JSON_HASH_PRIME;
+		p++;
+	}
+	keyLength = ( (p - key) > 255 ) ? 255 : (p - key);
+
+	if( !expect('"') )
+	{
+		fail();
+		return false;
+	}
+	skipSpace();
+	if( !expect(':') )
+	{
+		fail();
+		return false;
+	}
+	skipSpace();
+
+	return true;
+}
+
+/**
+ * Returns the hash of the current key
+ */
+uint32_t JsonReader::getKeyHash()
+{
+	return keyHash;
+}
+
+/**
+ * Returns true if the current key is the one given; confirms a hash match
+ */
+uint8_t JsonReader::isKey(const char* k)
+{
+	return ( strlen(k) == keyLength && memcmp(k, key, keyLength) == 0 );
+}
+
+/**
+ * Returns the offset of the current value from the start of the text
+ */
+uint16_t JsonReader::getOffset()
+{
+	return (p - begin);
+}
+
+/**
+ * Moves over the next array element and returns where it lies in the
+ * text.  Returns false at the end of the array or on bad text.
+ *
+ */
+uint8_t JsonReader::nextElement(const uint8_t** element, uint16_t* length)
+{
+	if( !valid )
+	{
+		return false;
+	}
+
+	skipSpace();
+	if( expect(']') )
+	{
+		p = end;
+		return false;
+	}
+	if( !first && !expect(',') )
+	{
+		fail();
+		return false;
+	}
+	first = false;
+
+	skipSpace();
+	*element = p;
+	skipValue();
+	*length = p - *element;
+
+	return true;
+}
+
+/**
+ * Reads the value as an unsigned number.  Fractions are dropped, negative
+ * numbers wrap, true is 1, false and null are 0 and quoted numbers are
+ * read as numbers.  Anything else is skipped and reads as 0.
+ *
+ */
+uint32_t JsonReader::readNumber()
+{
+	const uint8_t* start = p;
+	uint32_t v = 0;
+	uint8_t negative = false;
+	uint8_t quoted = false;
+
+	if( p < end && (*p == 't' || *p == 'f' || *p == 'n') )
+	{
+		v = (*p == 't');
+		skipValue();
+		return v;
+	}
+
+	quoted = expect('"');
+	negative = expect('-');
+	if( p >= end || *p < '0' || *p > '9' )
+	{
+		p = start;
+		skipValue();
+		return 0;
+	}
+
+	while( p < end && *p >= '0' && *p <= '9' )
+	{
+		v = v*10 + (*p - '0');
+		p++;
+	}
+
+	// Drop any fraction and exponent
+	while( p < end && ((*p >= '0' && *p <= '9') || *p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-') )
+	{
+		p++;
+	}
+	if( quoted && !expect('"') )
+	{
+		fail();
+	}
+
+	return negative ? (uint32_t)(-(int32_t)v) : v;
+}
+
+/**
+ * Reads an array of numbers; values past the size are dropped.  Returns
+ * the number of values stored.
+ *
+ */
+uint16_t JsonReader::readArray(uint8_t* values, uint16_t size)
+{
+	uint16_t count = 0;
+	uint32_t v;
+
+	if( !expect('[') )
+	{
+		skipValue();
+		return 0;
+	}
+
+	skipSpace();
+	if( expect(']') )
+	{
+		return 0;
+	}
+
+	while( valid )
+	{
+		skipSpace();
+		v = readNumber();
+		if( count < size )
+		{
+			values[count++] = v;
+		}
+		skipSpace();
+		if( expect(']') )
+		{
+			break;
+		}
+		if( !expect(',') )
+		{
+			fail();
+		}
+	}
+
+	return count;
+}
+
+/**
+ * Skips the value, including nested arrays and objects
+ */
+void JsonReader::skipValue()
+{
+	uint8_t depth = 0;
+
+	while( p < end )
+	{
+		switch( *p )
+		{
+		case '"':
+			skipString();
+			continue;
+		case '[':
+		case '{':
+			depth++;
+			break;
+		case ']':
+		case '}':
+			if( depth == 0 )
+			{
+				return;
+			}
+			depth--;
+			break;
+		case ',':
+			if( depth == 0 )
+			{
+				return;
+			}
+			break;
+		}
+		p++;
+		if( depth == 0 && p < end && (*(p-1) == ']' || *(p-1) == '}') )
+		{
+			return;
+		}
+	}
+}
+
+/**
+ * Returns false if the text was not a well formed object
+ */
+uint8_t JsonReader::isValid()
+{
+	return valid;
+}
+
+/**
+ * Skips white space
+ */
+void JsonReader::skipSpace()
+{
+	while( p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') )
+	{
+		p++;
+	}
+}
+
+/**
+ * Consumes the character if it is next; returns true if it was
+ */
+uint8_t JsonReader::expect(uint8_t c)
+{
+	if( p < end && *p == c )
+	{
+		p++;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Skips a string, including escaped quotes
+ */
+void JsonReader::skipString()
+{
+	p++;
+	while( p < end && *p != '"' )
+	{
+		if( *p == '\\' )
+		{
+			p++;
+		}
+		p++;
+	}
+	if( p < end )
+	{
+		p++;
+	}
+	else
+	{
+		fail();
+	}
+}
+
+/**
+ * Marks the text bad and stops reading
+ */
+void JsonReader::fail()
+{
+	valid = false;
+	p = end;
+}
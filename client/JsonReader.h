@@ -0,0 +1,71 @@
+/*
+ * JsonReader.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#ifndef JSONREADER_H_
+#define JSONREADER_H_
+
+#include <Arduino.h>
+
+#include "ClientGlobal.h"
+
+#define JSON_HASH_SEED		2166136261UL
+#define JSON_HASH_PRIME		16777619UL
+
+/**
+ * FNV-1a hash of a key; usable as a case label.  Two keys with the same
+ * hash make a duplicate case, so the compiler checks the table is perfect.
+ */
+constexpr uint32_t jsonKey(const char* s, uint32_t h = JSON_HASH_SEED)
+{
+	return (*s == 0) ? h : jsonKey(s + 1, (h ^ (uint8_t)*s) * JSON_HASH_PRIME);
+}
+
+/**
+ * Single pass reader for flat JSON objects.
+ *
+ * Walks the text in place, without copying it or building a tree.  The
+ * caller loops on nextKey(), switches on the key hash and reads the value
+ * with the matching read function; values it does not want are skipped.
+ * Strings are not unescaped, so they can only be skipped or read as a
+ * number.  A reader opened on an array instead returns the span of each
+ * element from nextElement(), and one opened on 0 reads a single value.
+ */
+class JsonReader
+{
+public:
+	JsonReader(const uint8_t* b, uint16_t length, uint8_t open = '{');
+
+	uint8_t nextKey();
+	uint32_t getKeyHash();
+	uint8_t isKey(const char* key);
+	uint16_t getOffset();
+
+	uint8_t nextElement(const uint8_t** element, uint16_t* length);
+
+	uint32_t readNumber();
+	uint16_t readArray(uint8_t* values, uint16_t size);
+	void skipValue();
+
+	uint8_t isValid();
+
+protected:
+	const uint8_t* begin;
+	const uint8_t* p;
+	const uint8_t* end;
+	const uint8_t* key;
+	uint8_t keyLength;
+	uint32_t keyHash;
+	uint8_t valid;
+	uint8_t first;
+
+	void skipSpace();
+	uint8_t expect(uint8_t c);
+	void skipString();
+	void fail();
+};
+
+#endif /* JSONREADER_H_ */
@@ -59,6 +59,7 @@ uint8_t Menu::configure()
 		Serial.println(F("7 - Registration Channel"));
 		Serial.println(F("8 - Node Channel"));
 		Serial.println(F("9 - Response Channel"));
+		Serial.println(F("P - Power Budget"));
 
 		Serial.println(F("\nD - Dump Configuration"));
 		Serial.println(F("E - Save to Flash"));
@@ -88,9 +89,11 @@ uint8_t Menu::configure()
 		case '2':
 			Serial.print(F("** Change Number of LEDs**\nCurrent Number: "));
 			Serial.println(config->getNumberLeds());
-			Serial.print(F("\nPlease enter the new number (1-255) > "));
+			Serial.print(F("\nPlease enter the new number (1-"));
+			Serial.print(MAX_NUMBER_LEDS);
+			Serial.print(F(") > "));
 			id = Helper::readInt(b, INPUT_BUFFER_SIZE);
-			if (id > 0 && id <= 255)
+			if (id > 0 && id <= MAX_NUMBER_LEDS)
 			{
 				config->setNumberLeds(id);
 				Serial.print(F("\nNumber of LEDs: "));
@@ -220,6 +223,25 @@ uint8_t Menu::configure()
 			}
 			break;
 
+		case 'P':
+			Serial.print(F("** Change Power Budget **\nCurrent Budget (mA): "));
+			Serial.println(config->getPowerBudget());
+			Serial.print(F("\nPlease enter the new budget in mA (0 = no limit) > "));
+			id = Helper::readInt(b, INPUT_BUFFER_SIZE);
+			if (id >= 0)
+			{
+				config->setPowerBudget(id);
+				Serial.print(F("\nPower Budget: "));
+				Serial.println(config->getPowerBudget());
+				changed = 1;
+			}
+			else
+			{
+				Serial.print(F("\nERROR - illegal value entered: "));
+				Serial.println(id);
+			}
+			break;
+
 		case 'D':
 			Serial.println(F("\n** WIFI Configuration **"));
 			WiFi.printDiag(Serial);
@@ -0,0 +1,173 @@
+/*
+ * Metrics.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#include "Metrics.h"
+
+/**
+ * Constructor
+ */
+Metrics::Metrics()
+{
+	interval = MY_METRICS_INTERVAL;
+	lastSnapshot = 0;
+	requestedFps = 0;
+	mqttReconnects = 0;
+	wifiReconnects = 0;
+	wifiConnectTime = 0;
+	reset();
+}
+
+/**
+ * Sets the time between snapshots (ms); 0 stops them
+ */
+void Metrics::setInterval(uint32_t interval)
+{
+	this->interval = interval;
+}
+
+uint32_t Metrics::getInterval()
+{
+	return interval;
+}
+
+/**
+ * Returns true if it is time to publish a snapshot
+ */
+uint8_t Metrics::isDue(uint32_t now)
+{
+	return ( interval > 0 && (now - lastSnapshot) >= interval );
+}
+
+/**
+ * Records the time to parse a message
+ */
+void Metrics::recordParse(uint32_t time)
+{
+	add(parse, time);
+}
+
+/**
+ * Records the time a command waited in the queue (ms)
+ */
+void Metrics::recordQueueWait(uint32_t time)
+{
+	add(queueWait, time);
+}
+
+/**
+ * Records the time spent servicing MQTT
+ */
+void Metrics::recordLoop(uint32_t time)
+{
+	add(loop, time);
+}
+
+/**
+ * Records an animation frame: how late it was, how long show() took and
+ * whether it reached the LEDs or was skipped as unchanged
+ *
+ */
+void Metrics::recordFrame(uint32_t lateness, uint32_t showTime, uint8_t shown)
+{
+	frames += 1;
+	if( !shown )
+	{
+		skipped += 1;
+	}
+	if( lateness > maxLateness )
+	{
+		maxLateness = lateness;
+	}
+	add(show, showTime);
+}
+
+/**
+ * Sets the frame rate the running animation asked for; 0 if none runs
+ */
+void Metrics::setRequestedFps(uint8_t fps)
+{
+	requestedFps = fps;
+}
+
+/**
+ * Sets the connection counters reported with the next snapshot
+ */
+void Metrics::setReconnects(uint32_t mqtt, uint32_t wifi, uint32_t wifiConnectTime)
+{
+	mqttReconnects = mqtt;
+	wifiReconnects = wifi;
+	this->wifiConnectTime = wifiConnectTime;
+}
+
+/**
+ * Builds the snapshot of the interval just ended and starts the next one
+ *
+ */
+uint8_t Metrics::buildSnapshot(uint8_t* buffer, uint8_t nodeId, uint32_t now)
+{
+	uint32_t elapsed = now - lastSnapshot;
+
+	StaticJsonBuffer<CMD_BUFFER_SIZE> jsonBuffer;
+	JsonObject& root = jsonBuffer.createObject();
+
+	root[KEY_CMD] = CMD_METRICS;
+	root[KEY_NODE_ID] = nodeId;
+	root[KEY_METRICS_TIME] = elapsed;
+
+	// Average and largest per interval
+	root[KEY_METRICS_PARSE] = (parse.count > 0) ? parse.total / parse.count : 0;
+	root[KEY_METRICS_PARSE_MAX] = parse.max;
+	root[KEY_METRICS_WAIT] = (queueWait.count > 0) ? queueWait.total / queueWait.count : 0;
+	root[KEY_METRICS_WAIT_MAX] = queueWait.max;
+	root[KEY_METRICS_LOOP] = (loop.count > 0) ? loop.total / loop.count : 0;
+	root[KEY_METRICS_LOOP_MAX] = loop.max;
+	root[KEY_METRICS_SHOW] = (show.count > 0) ? show.total / show.count : 0;
+	root[KEY_METRICS_SHOW_MAX] = show.max;
+
+	root[KEY_METRICS_FRAMES] = frames;
+	root[KEY_METRICS_SKIPPED] = skipped;
+	root[KEY_METRICS_FPS] = (elapsed > 0) ? frames * 1000 / elapsed : 0;
+	root[KEY_FPS] = requestedFps;
+	root[KEY_METRICS_LATENESS] = maxLateness;
+
+	root[KEY_METRICS_RECONNECTS] = mqttReconnects;
+	root[KEY_METRICS_WIFI_LOST] = wifiReconnects;
+	root[KEY_METRICS_WIFI_TIME] = wifiConnectTime;
+	root[KEY_METRICS_HEAP] = ESP.getFreeHeap();
+	root[KEY_METRICS_BLOCK] = ESP.getMaxFreeBlockSize();
+
+	root.printTo((char *)buffer, CMD_BUFFER_SIZE);
+
+	lastSnapshot = now;
+	reset();
+
+	return true;
+}
+
+void Metrics::add(MetricStat& s, uint32_t v)
+{
+	s.count += 1;
+	s.total += v;
+	if( v > s.max )
+	{
+		s.max = v;
+	}
+}
+
+/**
+ * Starts the counters of a new interval
+ */
+void Metrics::reset()
+{
+	memset(&parse, 0, sizeof(parse));
+	memset(&queueWait, 0, sizeof(queueWait));
+	memset(&loop, 0, sizeof(loop));
+	memset(&show, 0, sizeof(show));
+	frames = 0;
+	skipped = 0;
+	maxLateness = 0;
+}
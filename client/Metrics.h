@@ -0,0 +1,74 @@
+/*
+ * Metrics.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "ClientGlobal.h"
+#include "Command.h"
+
+/**
+ * Count, sum and largest of a measured time
+ */
+typedef struct
+{
+	uint32_t count;
+	uint32_t total;
+	uint32_t max;
+} MetricStat;
+
+/**
+ * Node performance counters, published as a snapshot on the response
+ * channel every interval.
+ *
+ * Recording a value is an add and a compare, so the counters stay on in
+ * production; the snapshot reports the interval since the last one and
+ * starts the counters over.  Times are in us, except queue wait in ms.
+ */
+class Metrics
+{
+public:
+	Metrics();
+
+	void setInterval(uint32_t interval);
+	uint32_t getInterval();
+	uint8_t isDue(uint32_t now);
+
+	void recordParse(uint32_t time);
+	void recordQueueWait(uint32_t time);
+	void recordLoop(uint32_t time);
+	void recordFrame(uint32_t lateness, uint32_t showTime, uint8_t shown);
+
+	uint8_t buildSnapshot(uint8_t* buffer, uint8_t nodeId, uint32_t now);
+	void setRequestedFps(uint8_t fps);
+	void setReconnects(uint32_t mqtt, uint32_t wifi, uint32_t wifiConnectTime);
+
+protected:
+	uint32_t interval;
+	uint32_t lastSnapshot;
+
+	MetricStat parse;
+	MetricStat queueWait;
+	MetricStat loop;
+	MetricStat show;
+	uint32_t frames;
+	uint32_t skipped;
+	uint32_t maxLateness;
+
+	uint8_t requestedFps;
+	uint32_t mqttReconnects;
+	uint32_t wifiReconnects;
+	uint32_t wifiConnectTime;
+
+	void add(MetricStat& s, uint32_t v);
+	void reset();
+};
+
+#endif /* METRICS_H_ */
@@ -11,1461 +11,1291 @@
 
 #include "NeopixelWrapper.h"
 
-CLEDController *ledController;
-
 /**
  * Constructor
  */
 NeopixelWrapper::NeopixelWrapper()
 {
 	leds = 0;
+	output = 0;
+	snapshot = 0;
+	transitionStart = 0;
+	transitionTime = 0;
 	intensity = DEFAULT_INTENSITY;
+	outputIntensity = DEFAULT_INTENSITY;
+	powerBudget = 0;
+	powerDraw = 0;
+	powerPeak = 0;
+	powerScale = 100;
+	limitedFrames = 0;
+	numberLeds = 0;
+	bufferSize = 0;
+	numberSegments = 0;
+	target = LAYER_BASE;
+	for(uint8_t i=0; i<NUMBER_LAYERS; i++)
+	{
+		layers[i].pixels = 0;
+		layers[i].blend = BLEND_REPLACE;
+		layers[i].alpha = 255;
+		layers[i].dirty = false;
+	}
+	frameValid = false;
+	frameIntensity = 0;
+	frameFingerprint = 0;
+	shownFrames = 0;
+	skippedFrames = 0;
+	held = false;
+	showPending = false;
+#ifdef STAGED_OUTPUT
+	scratch = 0;
+	stageCycles = 0;
+	maxStageCycles = 0;
+	overBudgetFrames = 0;
+#endif
+#ifdef MY_INDEXED_PIXELS
+	indexes = 0;
+	paletteUsed = 0;
+#endif
+#ifdef MY_GAMMA_CORRECTION
+	lutIntensity = 0;
+	lutFraction = false;
+	ditherFrame = 0;
+	buildGamma();
+	buildLut();
+#endif
 }
 
 
 /**
  * Initializes the library
  */
-boolean NeopixelWrapper::initialize(uint8_t numLeds, uint8_t intensity)
+boolean NeopixelWrapper::initialize(uint16_t numLeds, uint8_t intensity)
 {
 	boolean status = false;
+#ifdef STAGED_OUTPUT
+	uint16_t longest = 0;
+#endif
 
 	// Free memory if we already allocated it
-	if( leds != 0 )
+	endTransition();
+	for(uint8_t i=LAYER_OVERLAY; i<NUMBER_LAYERS; i++)
+	{
+		disableLayer(i);
+	}
+	if( layers[LAYER_BASE].pixels != 0 )
 	{
-		free(leds);
+		free(layers[LAYER_BASE].pixels);
 	}
 
-	// Allocate memory for LED buffer
-	leds = (CRGB *) malloc(sizeof(CRGB) * numLeds);
+	layout(numLeds);
+	frameValid = false;
+
+	// Allocate memory for LED buffer; parallel lanes may pad the last lane
+	bufferSize = segments[numberSegments-1].start + segments[numberSegments-1].length;
+#ifdef STAGED_OUTPUT
+	// Segments are converted into the scratch buffer one at a time as they are sent
+	if( scratch != 0 )
+	{
+		free(scratch);
+	}
+	for(uint8_t i=0; i<numberSegments; i++)
+	{
+		longest = max(longest, segments[i].length);
+	}
+	scratch = (CRGB *) malloc(sizeof(CRGB) * longest);
+#endif
+#ifdef MY_INDEXED_PIXELS
+	// One byte per LED
+	if( indexes != 0 )
+	{
+		free(indexes);
+	}
+	indexes = (uint8_t *) calloc(bufferSize, sizeof(uint8_t));
+	paletteUsed = 0;
+	paletteIndex(BLACK);
+	leds = 0;
+	if (indexes == 0 || scratch == 0)
+	{
+		Serial.println(F("ERROR - unable to allocate LED memory"));
+	}
+#else
+	leds = (CRGB *) malloc(sizeof(CRGB) * bufferSize);
+	layers[LAYER_BASE].pixels = leds;
+	output = leds;
+	target = LAYER_BASE;
+#ifdef STAGED_OUTPUT
+	if (leds == 0 || scratch == 0)
+#else
 	if (leds == 0)
+#endif
 	{
 		Serial.println(F("ERROR - unable to allocate LED memory"));
 	}
+#endif
 	else
 	{
-//		FastLED.addLeds<WS2812, D8>(leds, numLeds).setCorrection(TypicalLEDStrip); // string
-		ledController = &FastLED.addLeds<MY_CONTROLLER, MY_LED_PIN>(leds, numLeds).setCorrection(MY_COLOR_CORRECTION); // strip
+		status = true;
+#ifdef MY_PARALLEL_OUTPUT
+		// one block controller clocks every lane out together
+		segments[0].controller = &FastLED.addLeds<WS2811_PORTA, MY_NUMBER_SEGMENTS, MY_COLOR_ORDER>(leds, segments[0].length).setCorrection(OUTPUT_CORRECTION);
+		for(uint8_t i=1; i<numberSegments; i++)
+		{
+			segments[i].controller = segments[0].controller;
+		}
+#else
+		for(uint8_t i=0; i<numberSegments; i++)
+		{
+			segments[i].controller = addSegment(i);
+			if( segments[i].controller == 0 )
+			{
+				Serial.println(F("ERROR - unable to add LED segment"));
+				status = false;
+			}
+		}
+#endif
 		Helper::workYield();
 
 //		// set master brightness control
 //		FastLED.setBrightness(intensity);
-		status = true;
+		dumpLayout();
 	}
 
 	return status;
 }
 
 /**
- * Returns color of pixel, or null if out of bounds
- *
+ * Splits the logical strip across the segments in MY_SEGMENT_* order
  */
-CRGB NeopixelWrapper::getPixel(int16_t index)
+void NeopixelWrapper::layout(uint16_t numLeds)
 {
-	if( index <0 || index >= ledController->size() )
+	const uint8_t pins[MAX_NUMBER_SEGMENTS] = { MY_SEGMENT_PIN_0, MY_SEGMENT_PIN_1, MY_SEGMENT_PIN_2, MY_SEGMENT_PIN_3 };
+	const uint16_t lengths[MAX_NUMBER_SEGMENTS] = { MY_SEGMENT_LENGTH_0, MY_SEGMENT_LENGTH_1, MY_SEGMENT_LENGTH_2, MY_SEGMENT_LENGTH_3 };
+	uint16_t fixed = 0;
+	uint8_t shared = 0;
+	uint16_t start = 0;
+
+	numberLeds = numLeds;
+	numberSegments = MY_NUMBER_SEGMENTS;
+	if( numberSegments == 0 || numberSegments > MAX_NUMBER_SEGMENTS )
 	{
-	    return leds[index];
+		numberSegments = 1;
 	}
-	else
+
+	for(uint8_t i=0; i<numberSegments; i++)
 	{
-#ifdef __DEBUG
-    	Serial.print(F("WARN - pixel["));
-    	Serial.print(index);
-    	Serial.print(F("]="));
-    	Serial.print(color, HEX);
-    	Serial.println(F("-SKIPPING"));
+#ifdef MY_PARALLEL_OUTPUT
+		// lanes must be the same length
+		segments[i].pin = 12 + i;
+		segments[i].start = i * ((numLeds + numberSegments - 1) / numberSegments);
+		segments[i].length = (numLeds + numberSegments - 1) / numberSegments;
+#else
+		segments[i].pin = pins[i];
+		segments[i].length = lengths[i];
+		fixed += lengths[i];
+		if( lengths[i] == 0 )
+		{
+			shared += 1;
+		}
 #endif
-    	return 0;
+		segments[i].controller = 0;
+	}
+
+#ifndef MY_PARALLEL_OUTPUT
+	for(uint8_t i=0; i<numberSegments; i++)
+	{
+		if( segments[i].length == 0 && shared > 0 )
+		{
+			// share what is left; the last shared segment takes the remainder
+			segments[i].length = (fixed < numLeds) ? (numLeds - fixed) / shared : 0;
+			fixed += segments[i].length;
+			shared -= 1;
+			if( shared == 0 && fixed < numLeds )
+			{
+				segments[i].length += numLeds - fixed;
+			}
+		}
+		segments[i].start = start;
+		start += segments[i].length;
 	}
+	numberLeds = start;
+#endif
 }
 
 /**
- * Sets the color of pixel.  No action if pixel is out of bounds
- *
+ * Registers the FastLED controller for a segment.  The pin is a template
+ * argument, so every possible segment needs its own call.
  */
-void NeopixelWrapper::setPixel(int16_t index, CRGB color, uint8_t s)
+CLEDController* NeopixelWrapper::addSegment(uint8_t segment)
 {
-	if( index <0 || index >= ledController->size() )
+#ifdef STAGED_OUTPUT
+	CRGB* start = scratch;
+#else
+	CRGB* start = leds + segments[segment].start;
+#endif
+	uint16_t length = segments[segment].length;
+
+	switch(segment)
 	{
-	    leds[index] = color;
-		if (s)
+	case 0:
+		return &FastLED.addLeds<MY_CONTROLLER, MY_SEGMENT_PIN_0>(start, length).setCorrection(OUTPUT_CORRECTION);
+#if MY_NUMBER_SEGMENTS > 1
+	case 1:
+		return &FastLED.addLeds<MY_CONTROLLER, MY_SEGMENT_PIN_1>(start, length).setCorrection(OUTPUT_CORRECTION);
+#endif
+#if MY_NUMBER_SEGMENTS > 2
+	case 2:
+		return &FastLED.addLeds<MY_CONTROLLER, MY_SEGMENT_PIN_2>(start, length).setCorrection(OUTPUT_CORRECTION);
+#endif
+#if MY_NUMBER_SEGMENTS > 3
+	case 3:
+		return &FastLED.addLeds<MY_CONTROLLER, MY_SEGMENT_PIN_3>(start, length).setCorrection(OUTPUT_CORRECTION);
+#endif
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Turns on a layer, allocating its pixels on first use.  Output moves to
+ * a separate composition buffer while any overlay is enabled.
+ */
+uint8_t NeopixelWrapper::enableLayer(uint8_t layer, uint8_t blend, uint8_t alpha)
+{
+	if( layer >= NUMBER_LAYERS || layers[LAYER_BASE].pixels == 0 )
+	{
+		return false;
+	}
+
+	if( layers[layer].pixels == 0 )
+	{
+		if( !separateOutput() )
 		{
-			show();
-//			FastLED.show();
+			return false;
+		}
+
+		layers[layer].pixels = (CRGB *) calloc(bufferSize, sizeof(CRGB));
+		if( layers[layer].pixels == 0 )
+		{
+			Serial.println(F("ERROR - unable to allocate layer memory"));
+			return false;
 		}
 	}
-	else
+
+	if( layer != LAYER_BASE )
 	{
-#ifdef __DEBUG
-    	Serial.print(F("WARN - pixel["));
-    	Serial.print(index);
-    	Serial.print(F("]="));
-    	Serial.print(color, HEX);
-    	Serial.println(F("-SKIPPING"));
-#endif
+		layers[layer].blend = blend;
+		layers[layer].alpha = alpha;
 	}
+	layers[layer].dirty = true;
 
+	return true;
 }
 
-void NeopixelWrapper::show()
+/**
+ * Turns off an overlay and releases its pixels.  The base layer stays.
+ */
+void NeopixelWrapper::disableLayer(uint8_t layer)
 {
-	ledController->showLeds(intensity);
-//
-//	FastLED.show();
+	if( layer == LAYER_BASE || layer >= NUMBER_LAYERS || layers[layer].pixels == 0 )
+	{
+		return;
+	}
+
+	if( target == layer )
+	{
+		selectLayer(LAYER_BASE);
+	}
+	free(layers[layer].pixels);
+	layers[layer].pixels = 0;
+	layers[LAYER_BASE].dirty = true;
+
+	releaseOutput();
 }
 
 /**
- * Returns the hue update time
+ * Selects the layer the drawing functions work on.  Returns false if the
+ * layer is not enabled.
  */
-uint8_t NeopixelWrapper::getIntensity()
+uint8_t NeopixelWrapper::selectLayer(uint8_t layer)
 {
-	return intensity;
-//	return FastLED.getBrightness();
+	if( !isLayerEnabled(layer) )
+	{
+		return false;
+	}
+	target = layer;
+	leds = layers[layer].pixels;
+	return true;
 }
 
 /**
- * Changes the amount of time to wait before updating the hue
- *
+ * Returns true if the layer has pixels
  */
-void NeopixelWrapper::setIntensity(uint8_t i)
+uint8_t NeopixelWrapper::isLayerEnabled(uint8_t layer)
 {
-	intensity = i;
-//	FastLED.setBrightness(i);
+	return ( layer < NUMBER_LAYERS && layers[layer].pixels != 0 );
 }
 
 /**
- * fills all pixels with specified color
- *
- * @color - color to set
- * @show - if true, sets color immediately
+ * Returns the pixels of a layer, or null if it is not enabled
  */
-void NeopixelWrapper::fill(CRGB color, uint8_t s)
+CRGB* NeopixelWrapper::getLayer(uint8_t layer)
 {
-	resetIntensity();
+	if( layer < NUMBER_LAYERS )
+	{
+		return layers[layer].pixels;
+	}
+	return 0;
+}
 
-	for (uint8_t i = 0; i < ledController->size(); i++)
-    {
-        leds[i] = color;
-    }
-	worker();
-    if (s)
-    {
-    	show();
-//        FastLED.show();
-    }
+/**
+ * Flags a layer as changed; the frame is composed again on the next show()
+ */
+void NeopixelWrapper::markDirty(uint8_t layer)
+{
+	if( layer < NUMBER_LAYERS )
+	{
+		layers[layer].dirty = true;
+	}
 }
 
 /**
- * Fills pixels with specified pattern, starting at 0. 1 = on, 0 = off.
- *
- * Repeats pattern every 8 pixels.
- *
+ * Gives the LEDs their own output buffer so the layers can be composed
+ * or crossfaded into it.  Returns false if there is no memory.
  */
-void NeopixelWrapper::fillPattern(uint8_t pattern, CRGB onColor, CRGB offColor)
+uint8_t NeopixelWrapper::separateOutput()
 {
-	resetIntensity();
-	setPattern(0, ledController->size(), pattern, 8, onColor, offColor, true);
+	if( output == layers[LAYER_BASE].pixels )
+	{
+		output = (CRGB *) malloc(sizeof(CRGB) * bufferSize);
+		if( output == 0 )
+		{
+			Serial.println(F("ERROR - unable to allocate output memory"));
+			output = layers[LAYER_BASE].pixels;
+			return false;
+		}
+		memcpy(output, layers[LAYER_BASE].pixels, sizeof(CRGB) * bufferSize);
+		attachOutput(output);
+	}
+	return true;
 }
 
 /**
- * Turns on LEDs one at time in sequence.  LEFT = 0->n; RIGHT = n -> 0
- *
- * @direction - left (up) or right (down)
- * @onColor - color to fill LEDs with
- * @offColor - color to fill LEDs with
- * @onTime - time to keep LED on
- * @offTime - time to keep LED off
- * @clearAfter - turn LED off after waiting
- * @clearEnd - clear after complete
+ * Without overlays or a transition the LEDs read the base layer directly
  */
-void NeopixelWrapper::wipe(uint16_t repeat, uint32_t duration, uint8_t direction, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime, uint8_t clearAfter, uint8_t clearEnd)
+void NeopixelWrapper::releaseOutput()
 {
-	uint16_t count = 0;
-	uint32_t endTime = millis() + duration;
+	if( output == layers[LAYER_BASE].pixels || snapshot != 0 )
+	{
+		return;
+	}
+	for(uint8_t i=LAYER_OVERLAY; i<NUMBER_LAYERS; i++)
+	{
+		if( layers[i].pixels != 0 )
+		{
+			return;
+		}
+	}
 
-	resetIntensity();
+	attachOutput(layers[LAYER_BASE].pixels);
+	free(output);
+	output = layers[LAYER_BASE].pixels;
+	layers[LAYER_BASE].dirty = true;
+}
 
-	// clear LEDs
-	fill(offColor, true);
+/**
+ * Starts a crossfade from the frame on the LEDs to whatever is drawn next.
+ * Call before drawing the new frame.  Returns false if there is no memory
+ * or the LEDs are indexed.
+ */
+uint8_t NeopixelWrapper::startTransition(uint32_t time)
+{
+	if( time == 0 || layers[LAYER_BASE].pixels == 0 )
+	{
+		return false;
+	}
 
-	while (isCommandAvailable() == false)
+	// Keep the outgoing frame; a running transition continues from where it is
+	if( snapshot == 0 )
 	{
-		// Set start location
-		if( direction == LEFT )
+		snapshot = (CRGB *) malloc(sizeof(CRGB) * bufferSize);
+		if( snapshot == 0 )
 		{
-			// Loop through all LEDs
-			for(uint8_t j=0; j<ledController->size(); j++ )
-			{
-				leds[j] = onColor;
-				show();
-//				FastLED.show();
-				if( commandDelay(onTime) ) break;
-				if( clearAfter )
-				{
-					leds[j] = offColor;
-					show();
-//					FastLED.show();
-					if( commandDelay(offTime) ) break;
-				}
+			Serial.println(F("ERROR - unable to allocate transition memory"));
+			return false;
+		}
+	}
+	memcpy(snapshot, output, sizeof(CRGB) * bufferSize);
 
-			} // end for j
+	if( !separateOutput() )
+	{
+		free(snapshot);
+		snapshot = 0;
+		return false;
+	}
 
-		} // end if LEFT
-		else if(direction == RIGHT )
-		{
-			// Loop through all LEDs
-			for(int16_t j=ledController->size()-1; j>=0; j -=1 )
-			{
-				leds[j] = onColor;
-				show();
-//					FastLED.show();
-				if( commandDelay(onTime) ) break;
-				if( clearAfter )
-				{
-					leds[j] = offColor;
-					show();
-//					FastLED.show();
-					if( commandDelay(offTime) ) break;
-				}
+	transitionStart = millis();
+	transitionTime = time;
+	layers[LAYER_BASE].dirty = true;
 
-			} // end for j
-		} //end if RIGHT
+	return true;
+}
 
-		count += 1;
-		if( repeat > 0 && count >= repeat )
-		{
-			break;
-		}
-		if( duration > 0 && millis() > endTime )
-		{
-			break;
-		}
+/**
+ * Returns true while a crossfade is running; show() has to be called
+ * until it ends even if nothing else changes
+ */
+uint8_t NeopixelWrapper::isTransitioning()
+{
+	return (snapshot != 0);
+}
 
-	} // end while
+/**
+ * Returns true while temporal dither shows levels between the output
+ * steps; show() has to be called even if nothing changes, or the dither
+ * stops on one phase
+ */
+uint8_t NeopixelWrapper::isDithering()
+{
+#if defined(MY_GAMMA_CORRECTION) && defined(MY_TEMPORAL_DITHER)
+	return lutFraction;
+#else
+	return false;
+#endif
+}
 
-	if( clearEnd )
+/**
+ * Ends the crossfade and releases the outgoing frame
+ */
+void NeopixelWrapper::endTransition()
+{
+	if( snapshot != 0 )
 	{
-		fill(offColor, true);
+		free(snapshot);
+		snapshot = 0;
+		layers[LAYER_BASE].dirty = true;
+		releaseOutput();
 	}
 }
 
 /**
- * Rotates a pattern across the strip; onTime determines pause between rotation
+ * Blends the outgoing frame into the output buffer.  Weight is 8.8 fixed
+ * point: 0 keeps the outgoing frame, 256 is all new frame.
  *
- * NOTE: Starts at 0, and repeats every 8 pixels through end of strip
+ * Channels blend independently, so the buffers are treated as bytes and
+ * run four at a time: the even and odd bytes of a word are split into two
+ * words of 16 bit lanes, which leaves room for the 8.8 products.
  */
-void NeopixelWrapper::rotatePattern(uint16_t repeat, uint32_t duration, uint8_t pattern, uint8_t direction, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime)
+void NeopixelWrapper::crossfade(uint16_t weight)
 {
-	uint16_t i = 0;
-	uint16_t count = 0;
-	uint32_t endTime = millis() + duration;
-
-	resetIntensity();
+	uint32_t *from = (uint32_t *)snapshot;
+	uint32_t *to = (uint32_t *)output;
+	uint16_t bytes = sizeof(CRGB) * numberLeds;
+	uint16_t words = bytes / 4;
+	uint16_t inverse = 256 - weight;
+	uint32_t a, b;
+	uint32_t even, odd;
+
+	for(uint16_t i=0; i<words; i++)
+	{
+		a = from[i];
+		b = to[i];
+		even = ((a & 0x00FF00FF) * inverse + (b & 0x00FF00FF) * weight) >> 8;
+		odd = ((a >> 8) & 0x00FF00FF) * inverse + ((b >> 8) & 0x00FF00FF) * weight;
+		to[i] = (even & 0x00FF00FF) | (odd & 0xFF00FF00);
+	}
 
-	while (isCommandAvailable() == false)
+	// Buffers are malloc aligned; only the last few bytes are left over
+	uint8_t *f = (uint8_t *)snapshot;
+	uint8_t *t = (uint8_t *)output;
+	for(uint16_t i=words*4; i<bytes; i++)
 	{
-		setPattern(0, ledController->size(), pattern, 8, onColor, offColor, true);
-		if (commandDelay(onTime)) break;
-		if (direction == LEFT)
-		{
-			if (pattern & 0x80)
-			{
-				i = 0x01;
-			}
-			else
-			{
-				i = 0x00;
-			}
-			pattern = pattern << 1;
-			pattern = pattern | i;
-		}
-		else if (direction == RIGHT)
-		{
-			if (pattern & 0x01)
-			{
-				i = 0x80;
-			}
-			else
-			{
-				i = 0x00;
-			}
-			pattern = pattern >> 1;
-			pattern = pattern | i;
-		}
+		t[i] = (f[i] * inverse + t[i] * weight) >> 8;
+	}
+}
 
-		count += 1;
-		if( repeat > 0 && count >= repeat )
-		{
-			break;
-		}
-		if( duration > 0 && millis() > endTime )
+/**
+ * Points every segment at the buffer the LEDs are sent from
+ */
+void NeopixelWrapper::attachOutput(CRGB* buffer)
+{
+#if defined(STAGED_OUTPUT)
+	// the segments always send from the scratch buffer
+#elif defined(MY_PARALLEL_OUTPUT)
+	if( segments[0].controller != 0 )
+	{
+		segments[0].controller->setLeds(buffer, segments[0].length);
+	}
+#else
+	for(uint8_t i=0; i<numberSegments; i++)
+	{
+		if( segments[i].controller != 0 )
 		{
-			break;
+			segments[i].controller->setLeds(buffer + segments[i].start, segments[i].length);
 		}
-
-	} // end while
+	}
+#endif
 }
 
 /**
- * Turns on LEDs one at time in sequence.  LEFT = 0->n; RIGHT = n -> 0
- *
- * NOTE: starts with pattern "off" the screen and scrolls "on" the screen,
- *       then "off" the screen again
- *
- * @pattern - the pattern to wipe
- * @direction - left (up) or right (down)
- * @onColor - color to fill LEDs with
- * @offColor - color to fill LEDs with
- * @onTime - time to keep LED on
- * @offTime - time to keep LED off
- * @clearAfter - turn LED off after waiting
- * @clearEnd - clear after complete
+ * Composes the layers into the output buffer if any of them changed
  */
-void NeopixelWrapper::scrollPattern(uint16_t repeat, uint32_t duration, uint8_t pattern, uint8_t patternLength, uint8_t direction, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime, uint8_t clearAfter, uint8_t clearEnd)
+void NeopixelWrapper::compose()
 {
-	uint16_t count = 0;
-	uint32_t endTime = millis() + duration;
+	uint8_t dirty = false;
+	CRGB* src;
 
-	CRGB pixels[patternLength];
-	int16_t curIndex;
+	uint32_t elapsed;
 
-	resetIntensity();
+	for(uint8_t i=0; i<NUMBER_LAYERS; i++)
+	{
+		dirty |= layers[i].dirty;
+		layers[i].dirty = false;
+	}
 
-	// Initialize the pixel buffer
-	for(uint8_t i=0; i<patternLength; i++)
+	// A crossfade changes the output every frame
+	if( snapshot != 0 )
 	{
-		// rotates pattern and tests for "on"
-		if ((pattern >> i) & 0x01)
+		elapsed = millis() - transitionStart;
+		if( elapsed >= transitionTime )
 		{
-			pixels[i] = onColor;
+			endTransition();
+			dirty = true;
 		}
 		else
 		{
-			pixels[i] = offColor;
+			dirty = true;
 		}
 	}
 
-	// clear LEDs
-	fill(offColor, true);
-
+	// Nothing to do if nothing changed or the base layer is the output
+	if( !dirty || output == layers[LAYER_BASE].pixels )
+	{
+		return;
+	}
 
-	while (isCommandAvailable() == false)
+	memcpy(output, layers[LAYER_BASE].pixels, sizeof(CRGB) * numberLeds);
+	for(uint8_t l=LAYER_OVERLAY; l<NUMBER_LAYERS; l++)
 	{
-		// Loop through all LEDs (plus some)
-		for(int16_t j=0; j<(ledController->size()+patternLength-1); j++ )
+		src = layers[l].pixels;
+		if( src == 0 )
 		{
-	        // Set start location
-			if( direction == LEFT )
-			{
-				if( (j >= (patternLength-1)) && (j <= (ledController->size() - 1)) )
-				{
-					// copy all pixels to leds
-					curIndex = j;
-					for(uint8_t i=0; i<patternLength; i++)
-					{
-						leds[curIndex--] = pixels[i];
-					}
-				}
-				else if( j <= (patternLength-1) )
-				{
-					curIndex = j;
-					uint8_t bitsToCopy = j+1;
+			continue;
+		}
 
-					for(uint8_t i=0; i< bitsToCopy; i++)
-					{
-						leds[curIndex--] = pixels[i];
-					}
-				}
-				else if(j > (ledController->size()-1))
+		switch( layers[l].blend )
+		{
+		case BLEND_ADD:
+			for(uint16_t i=0; i<numberLeds; i++)
+			{
+				output[i] += src[i];
+			}
+			break;
+		case BLEND_MAX:
+			for(uint16_t i=0; i<numberLeds; i++)
+			{
+				output[i] |= src[i];
+			}
+			break;
+		case BLEND_ALPHA:
+			for(uint16_t i=0; i<numberLeds; i++)
+			{
+				if( src[i] )
 				{
-					curIndex = ledController->size()-1;
-					uint8_t bitsToCopy = (patternLength-1) - (j-ledController->size());
-					uint8_t start = (patternLength-bitsToCopy);
-	#ifdef __DEBUG
-					Serial.print(F("j="));
-					Serial.print(j);
-					Serial.print(F(", curIndex="));
-					Serial.print(curIndex);
-					Serial.print(F(", bitsToCopy="));
-					Serial.print(bitsToCopy);
-					Serial.print(F(", start="));
-					Serial.println(start);
-	#endif
-					for(uint8_t i=start; i< 8; i++)
-					{
-	#ifdef __DEBUG
-						Serial.print(F("curIndex="));
-						Serial.print(curIndex);
-						Serial.print(F(", i="));
-						Serial.println(i);
-	#endif
-						leds[curIndex--] = pixels[i];
-					}
+					nblend(output[i], src[i], layers[l].alpha);
 				}
-			} // end if LEFT
-			else if(direction == RIGHT )
+			}
+			break;
+		case BLEND_REPLACE:
+		default:
+			for(uint16_t i=0; i<numberLeds; i++)
 			{
-				if( (j >= (patternLength-1)) && (j <= (ledController->size() - 1)) )
+				if( src[i] )
 				{
-					// copy all pixels to leds
-					curIndex = ledController->size() - j - 1;
-					for(uint8_t i=0; i<patternLength; i++)
-					{
-						leds[curIndex++] = pixels[i];
-					}
+					output[i] = src[i];
 				}
-				else if( j < (patternLength-1) )
-				{
-					curIndex = ledController->size() - j - 1;
-					uint8_t bitsToCopy = ledController->size() - curIndex;
+			}
+			break;
+		}
+	}
 
-					for(uint8_t i=0; i< bitsToCopy; i++)
-					{
-						leds[curIndex++] = pixels[i];
-					}
-				}
-				else if(j > (ledController->size()-1))
-				{
-					curIndex = 0;
-					uint8_t bitsToCopy = (patternLength-1) - (j-ledController->size());
-					uint8_t start = (patternLength-bitsToCopy);
-	#ifdef __DEBUG
-					Serial.print(F("j="));
-					Serial.print(j);
-					Serial.print(F(", curIndex="));
-					Serial.print(curIndex);
-					Serial.print(F(", bitsToCopy="));
-					Serial.print(bitsToCopy);
-					Serial.print(F(", start="));
-					Serial.println(start);
-	#endif
-					for(uint8_t i=start; i< 8; i++)
-					{
-	#ifdef __DEBUG
-						Serial.print(F("curIndex="));
-						Serial.print(curIndex);
-						Serial.print(F(", i="));
-						Serial.println(i);
-	#endif
-						leds[curIndex++] = pixels[i];
-					}
-				}
-			} //end if RIGHT
-
-			show();
-//					FastLED.show();
-			commandDelay(onTime);
-			if( clearAfter )
-			{
-				fill(offColor, false);
-			}
-
-		} // end for j
-
-		count += 1;
-		if( repeat > 0 && count >= repeat )
-		{
-			break;
-		}
-		if( duration > 0 && millis() > endTime )
-		{
-			break;
-		}
-
-	} // end while
-
-	if( clearEnd )
+	if( snapshot != 0 )
 	{
-		fill(offColor, true);
+		crossfade( (elapsed << 8) / transitionTime );
 	}
 }
 
 /**
- * Bounces the specified pattern the specified direction.
- *
- * NOTE: Pattern does not double flash at the ends.
- *
+ * Returns the number of physical outputs
  */
-void NeopixelWrapper::bounce(uint16_t repeat, uint32_t duration, uint8_t pattern, uint8_t patternLength, uint8_t direction, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime, uint32_t bounceTime, uint8_t clearAfter, uint8_t clearEnd)
+uint8_t NeopixelWrapper::getNumberSegments()
 {
-	// custom bounce with 0-7, n-(n-7)
-	resetIntensity();
-
-	uint16_t count = 0;
-	uint32_t endTime = millis() + duration;
-
-	uint8_t first = true;
-	uint8_t lstart = 0;
-	uint8_t lend = 0;
-	uint8_t rstart = 0;
-	uint8_t rend = 0;
-
-	resetIntensity();
-
-	if (direction == LEFT)
-	{
-		lstart = 0;
-		lend = ledController->size() - patternLength;
-
-		rstart = ledController->size() - patternLength - 1;
-		rend = 0;
-	}
-	else if (direction == RIGHT)
-	{
-		rstart = ledController->size() - patternLength;
-		rend = 0;
+	return numberSegments;
+}
 
-		lstart = 1;
-		lend = ledController->size() - patternLength;
-	}
-	else
+/**
+ * Returns the segment, or null if out of bounds
+ */
+Segment* NeopixelWrapper::getSegment(uint8_t segment)
+{
+	if( segment < numberSegments )
 	{
-		return;
+		return &segments[segment];
 	}
+	return 0;
+}
 
-	// Fill with off color
-	fill(offColor, true);
+/**
+ * Returns the estimated time in us to push one frame to the LEDs.
+ *
+ * Separate outputs are written one after the other, so their wire time
+ * adds up; parallel lanes are written together and cost the longest lane.
+ */
+uint32_t NeopixelWrapper::getFrameTime()
+{
+	uint32_t time = 0;
 
-	// work until we have a new command
-	while (isCommandAvailable() == false)
+	for(uint8_t i=0; i<numberSegments; i++)
 	{
-		if( direction == LEFT )
-		{
-			for(int16_t i=lstart; i<=lend; i++ )
-			{
-				setPattern(i, patternLength, pattern, patternLength, onColor, offColor, true);
-				if (commandDelay(onTime)) break;
-				if( clearAfter )
-				{
-					fill(offColor, true);
-					if (commandDelay(offTime)) break;
-				}
-			}
-			if( clearEnd )
-			{
-				fill(offColor, true);
-				if (commandDelay(bounceTime)) break;
-			}
-
-			for(int16_t i=rstart; i>=rend; i-=1 )
-			{
-				setPattern(i, patternLength, pattern, patternLength, onColor, offColor, true);
-				if (commandDelay(onTime)) break;
-				if( clearAfter )
-				{
-					fill(offColor, true);
-					if (commandDelay(offTime)) break;
-				}
-			}
-			if( clearEnd )
-			{
-				fill(offColor, true);
-				if (commandDelay(bounceTime)) break;
-			}
-
-			if( first )
-			{
-				lstart = 1;
-				lend = ledController->size() - patternLength - 1;
-				rstart = ledController->size() - patternLength;
-				rend = 0;
-				first = false;
-			}
-		}
-		else if(direction == RIGHT )
+#ifdef MY_PARALLEL_OUTPUT
+		if( (uint32_t)segments[i].length * LED_PIXEL_TIME > time )
 		{
-			for(int16_t i=rstart; i>=rend; i-=1 )
-			{
-				setPattern(i, patternLength, pattern, patternLength, onColor, offColor, true);
-				if (commandDelay(onTime)) break;
-				if( clearAfter )
-				{
-					fill(offColor, true);
-					if (commandDelay(offTime)) break;
-				}
-			}
-			if( clearEnd )
-			{
-				fill(offColor, true);
-				if (commandDelay(bounceTime)) break;
-			}
-			for(int16_t i=lstart; i<=lend; i++ )
-			{
-				setPattern(i, patternLength, pattern, patternLength, onColor, offColor, true);
-				if (commandDelay(onTime)) break;
-				if( clearAfter )
-				{
-					fill(offColor, true);
-					if (commandDelay(offTime)) break;
-				}
-			}
-			if( clearEnd )
-			{
-				fill(offColor, true);
-				if (commandDelay(bounceTime)) break;
-			}
-
-			if( first )
-			{
-				rstart = ledController->size() - patternLength -1;
-				rend = 0;
-
-				lstart = 1;
-				lend = ledController->size() - patternLength;
-				first = false;
-			}
-
+			time = (uint32_t)segments[i].length * LED_PIXEL_TIME;
 		}
+#else
+		time += (uint32_t)segments[i].length * LED_PIXEL_TIME;
+#endif
+	}
 
-		count += 1;
-		if( repeat > 0 && count >= repeat )
-		{
-			break;
-		}
-		if( duration > 0 && millis() > endTime )
-		{
-			break;
-		}
-
-	} // end while
-
-} // end bounce
-
+	return time + LED_LATCH_TIME;
+}
 
 /**
- * Starts in the middle and works out; or starts in the end and works in
+ * Returns the highest frame rate the segment layout can reach
  */
-void NeopixelWrapper::middle(uint16_t repeat, uint32_t duration, uint8_t direction, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime, uint8_t clearAfter, uint8_t clearEnd)
+uint16_t NeopixelWrapper::getMaxFramesPerSecond()
 {
-	uint16_t count = 0;
-	uint32_t endTime = millis() + duration;;
-
-	uint8_t numPixels = ledController->size();
-	uint8_t halfNumPixels = numPixels/2;
-
-	resetIntensity();
-	fill(offColor, true);
+	return 1000000UL / getFrameTime();
+}
 
-	while (isCommandAvailable() == false)
+/**
+ * Prints the segment layout and its timing
+ */
+void NeopixelWrapper::dumpLayout()
+{
+	for(uint8_t i=0; i<numberSegments; i++)
 	{
-		if(direction == IN)
-		{
-			for(uint8_t i=0; i<halfNumPixels; i++)
-			{
-				leds[i] = onColor;
-				leds[(numPixels-1)-i] = onColor;
-				show();
-//					FastLED.show();
-				if( commandDelay(onTime) ) return;
-
-				if( clearAfter == true )
-				{
-					leds[i] = offColor;
-					leds[(numPixels-1)-i] = offColor;
-					show();
-//					FastLED.show();
-					if( commandDelay(offTime) ) return;
-				}
-			}
-		}
-		else if( direction == OUT )
-		{
-			for(uint8_t i=0; i<halfNumPixels+1; i++)
-			{
-				leds[halfNumPixels-i] = onColor;
-				leds[halfNumPixels+i] = onColor;
-				show();
-//					FastLED.show();
-				if( commandDelay(onTime) ) return;
-
-				if( clearAfter == true )
-				{
-					leds[halfNumPixels-i] = offColor;
-					leds[halfNumPixels+i] = offColor;
-					show();
-//					FastLED.show();
-					if( commandDelay(offTime) ) return;
-				}
-			}
-		}
-		if(clearEnd)
-		{
-			fill(offColor, true);
-		}
-
-		count += 1;
-		if( repeat > 0 && count >= repeat )
-		{
-			break;
-		}
-
-		if( duration > 0 && millis() > endTime )
-		{
-			break;
-		}
-
-	} // end while
+		Serial.print(F("Segment "));
+		Serial.print(i);
+		Serial.print(F(": pin="));
+		Serial.print(segments[i].pin);
+		Serial.print(F(", start="));
+		Serial.print(segments[i].start);
+		Serial.print(F(", length="));
+		Serial.println(segments[i].length);
+	}
+	Serial.print(F("Frame time: "));
+	Serial.print(getFrameTime());
+	Serial.print(F("us, max fps: "));
+	Serial.println(getMaxFramesPerSecond());
 }
 
 /**
- * Flashes random LED with specified color
+ * Returns color of pixel, or null if out of bounds
+ *
  */
-void NeopixelWrapper::randomFlash(uint16_t repeat, uint32_t duration, uint32_t onTime, uint32_t offTime, CRGB onColor, CRGB offColor, uint8_t number)
+CRGB NeopixelWrapper::getPixel(int16_t index)
 {
-	uint16_t count = 0;
-	uint32_t endTime = millis() + duration;;
-
-	uint8_t i, j;
-
-	resetIntensity();
-	fill(offColor, true);
-	if( number == 0)
+	if( index >= 0 && index < size() )
 	{
-		number = 1;
+#ifdef MY_INDEXED_PIXELS
+		return palette[ indexes[index] ];
+#else
+	    return leds[index];
+#endif
 	}
-	if( number > ledController->size() )
+	else
 	{
-		number = ledController->size();
+#ifdef __DEBUG
+    	Serial.print(F("WARN - pixel["));
+    	Serial.print(index);
+    	Serial.println(F("]-SKIPPING"));
+#endif
+    	return 0;
 	}
+}
 
-	while (isCommandAvailable() == false)
+/**
+ * Sets the color of pixel.  No action if pixel is out of bounds
+ *
+ */
+void NeopixelWrapper::setPixel(int16_t index, CRGB color, uint8_t s)
+{
+	if( index >= 0 && index < size() )
 	{
-		for(j=0; j<number; j++)
-		{
-			do
-			{
-				i = random(ledController->size());
-
-			} while( leds[i] != offColor );
-
-			if( onColor == (CRGB)RAINBOW )
-			{
-				leds[i] = CHSV(random8(0, 255), 255, 255);
-			}
-			else
-			{
-				leds[i] = onColor;
-			}
-		}
-
-		show();
-
-		if (commandDelay(onTime)) break;
-		fill(offColor, true);
-//		leds[i] = offColor;
-		if (commandDelay(offTime)) break;
-
-		count += 1;
-		if( repeat > 0 && count >= repeat )
-		{
-			break;
-		}
-
-		if( duration > 0 && millis() > endTime )
+#ifdef MY_INDEXED_PIXELS
+		indexes[index] = paletteIndex(color);
+#else
+	    leds[index] = color;
+#endif
+	    layers[target].dirty = true;
+		if (s)
 		{
-			break;
+			show();
+//			FastLED.show();
 		}
-
+	}
+	else
+	{
+#ifdef __DEBUG
+    	Serial.print(F("WARN - pixel["));
+    	Serial.print(index);
+    	Serial.print(F("]="));
+    	Serial.print(color, HEX);
+    	Serial.println(F("-SKIPPING"));
+#endif
 	}
 
-	fill(offColor, true);
-
-} // randomFlash
-
+}
 
 /**
- * Fades LEDs up or down with the specified time increment
+ * Copies count pixels, packed R, G, B, into the LEDs from start; pixels
+ * past the end are dropped.  Returns the number of pixels set.
+ *
  */
-void NeopixelWrapper::fade(uint8_t direction, uint8_t fadeIncrement, uint32_t time, CRGB color)
+uint16_t NeopixelWrapper::setPixels(uint16_t start, const uint8_t* rgb, uint16_t count, uint8_t s)
 {
-	int16_t i=0;
-
-	if( direction == DOWN )
+	if( start >= size() )
 	{
-//		FastLED.setBrightness(255);
-//		FastLED.showColor(color);
-		intensity = 255;
+		return 0;
 	}
-	else if( direction == UP )
+	if( count > size() - start )
 	{
-//		FastLED.setBrightness(0);
-//		FastLED.showColor(color);
-		intensity = 0;
+		count = size() - start;
 	}
-	ledController->showColor(color, intensity);
 
-	while(i<255)
+#ifdef MY_INDEXED_PIXELS
+	for(uint16_t i=0; i<count; i++, rgb += 3)
 	{
-		if( commandDelay(time) ) break;
-		i = i+fadeIncrement;
-
-		if( i > 255)
-		{
-			i = 255;
-		}
-
-		if( direction == DOWN )
-		{
-			intensity = 255-i;
-//			FastLED.setBrightness(255-i);
-		}
-		else if( direction == UP)
-		{
-			intensity = i;
-//			FastLED.setBrightness(i);
-		}
-		ledController->showColor(color, intensity);
-//		FastLED.showColor(color);
-
+		indexes[start + i] = paletteIndex( CRGB(rgb[0], rgb[1], rgb[2]) );
 	}
-
-}
-
-/**
- * Flashes LEDs
- */
-void NeopixelWrapper::strobe(uint16_t repeat, uint32_t duration, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime )
-{
-	uint16_t count = 0;
-	uint32_t endTime = millis() + duration;;
-
-	resetIntensity();
-
-	while( isCommandAvailable() == false )
+#else
+	memcpy( (uint8_t *)(leds + start), rgb, sizeof(CRGB) * count );
+#endif
+	layers[target].dirty = true;
+	if (s)
 	{
-		fill(onColor, true);
-		if( commandDelay(onTime) ) break;
-		fill(offColor, true);
-		if( commandDelay(offTime) ) break;
-
-		count += 1;
-		if( repeat > 0 && count >= repeat )
-		{
-			break;
-		}
-
-		if( duration > 0 && millis() > endTime )
-		{
-			break;
-		}
+		show();
+	}
 
-	} // end while command
+	return count;
 }
 
-
 /**
- * Creates lightning effort
+ * Returns the pixels of the selected layer; animations render straight into it
  */
-void NeopixelWrapper::lightning(uint16_t repeat, uint32_t duration, CRGB onColor, CRGB offColor)
+CRGB* NeopixelWrapper::getLeds()
 {
-	uint16_t count = 0;
-	uint32_t endTime = millis() + duration;;
-
-	uint32_t large;
-	uint8_t i, b;
-
-	b = false;
-	resetIntensity();
-
-    while(isCommandAvailable() == false )
-	{
-		for(i=0; i<count; i++)
-		{
-			large = random(0,100);
-			fill(onColor, true);
-			if( large > 40 && b == false)
-			{
-				if( commandDelay(random(100, 350)) ) break;
-				b = true;
-			}
-			else
-			{
-				if( commandDelay(random(20, 50)) ) break;
-			}
-			fill(offColor, true);
-			if( large > 40 && b == false )
-			{
-				if( commandDelay(random(200, 500)) ) break;
-			}
-			else
-			{
-				if( commandDelay(random(30, 70)) ) break;
-			}
-		}
-
-		count += 1;
-		if( repeat > 0 && count >= repeat )
-		{
-			break;
-		}
-
-		if( duration > 0 && millis() > endTime )
-		{
-			break;
-		}
-
-	} // end while command
+	return leds;
 }
 
 /**
- * Fills strip with rainbow pattern
- *
- * @glitter if true, randomly pops white into rainbow pattern
+ * Returns true if the LEDs are stored as palette indexes; getLeds() is
+ * null and only palette aware animations can run
  */
-void NeopixelWrapper::rainbow(uint32_t duration, uint8_t glitterProbability, CRGB glitterColor, uint32_t onTime, uint8_t hueUpdateTime)
+uint8_t NeopixelWrapper::isIndexed()
 {
-	uint8_t hue = 0;
-	uint32_t hueTime = 0;
-	uint32_t endTime = millis() + duration;
-
-	resetIntensity();
-	fill(BLACK, true);
-
-    while(isCommandAvailable() == false )
-    {
-        // FastLED's built-in rainbow generator
-        fill_rainbow(leds, ledController->size(), hue, 7);
-        if (glitterProbability > 0)
-        {
-            if (random8() < glitterProbability)
-            {
-                leds[random16(ledController->size())] += glitterColor;
-            }
-
-        }
-		show();
-//					FastLED.show();
-        commandDelay( onTime );
-        hueTime +=1;
-        if( hueTime == hueUpdateTime )
-        {
-        	hueTime = 0;
-        	hue += 1;
-        }
-
-		if( duration > 0 && millis() > endTime )
-		{
-			break;
-		}
-
-    } // end while command
-
-} // end rainbow
+#ifdef MY_INDEXED_PIXELS
+	return true;
+#else
+	return false;
+#endif
+}
 
 /**
- * This function draws rainbows with an ever-changing,widely-varying set of parameters.
- * https://gist.github.com/kriegsman/964de772d64c502760e5
- *
+ * Returns the number of LEDs
  */
-void NeopixelWrapper::rainbowFade(uint32_t duration, uint32_t onTime)
+uint16_t NeopixelWrapper::size()
 {
-	uint32_t endTime = millis() + duration;;
-
-	//TODO: Figure out to better control timing with FPS or hue update time
-
-	resetIntensity();
-	fill(BLACK, true);
-
-    while(isCommandAvailable() == false )
-    {
-
-        static uint16_t sPseudotime = 0;
-        static uint16_t sLastMillis = 0;
-        static uint16_t sHue16 = 0;
-
-        uint8_t sat8 = beatsin88(87, 220, 250);
-        uint8_t brightdepth = beatsin88(341, 96, 224);
-        uint16_t brightnessthetainc16 = beatsin88(203, (25 * 256), (40 * 256));
-        uint8_t msmultiplier = beatsin88(147, 23, 60);
-
-        uint16_t hue16 = sHue16; //gHue * 256;
-        uint16_t hueinc16 = beatsin88(113, 1, 3000);
-
-        uint16_t ms = millis();
-        uint16_t deltams = ms - sLastMillis;
-        sLastMillis = ms;
-        sPseudotime += deltams * msmultiplier;
-        sHue16 += deltams * beatsin88(400, 5, 9);
-        uint16_t brightnesstheta16 = sPseudotime;
-
-        for (uint16_t i = 0; i < (uint16_t) ledController->size(); i++)
-        {
-            hue16 += hueinc16;
-            uint8_t hue8 = hue16 / 256;
-
-            brightnesstheta16 += brightnessthetainc16;
-            uint16_t b16 = sin16(brightnesstheta16) + 32768;
-
-            uint16_t bri16 = (uint32_t) ((uint32_t) b16 * (uint32_t) b16) / 65536;
-            uint8_t bri8 = (uint32_t) (((uint32_t) bri16) * brightdepth) / 65536;
-            bri8 += (255 - brightdepth);
-
-            CRGB newcolor = CHSV(hue8, sat8, bri8);
-
-            uint16_t pixelnumber = i;
-            pixelnumber = (ledController->size() - 1) - pixelnumber;
-
-            nblend(leds[pixelnumber], newcolor, 64);
-        }
-
-		show();
-//					FastLED.show();
-        commandDelay( onTime );
-
-		if( duration > 0 && millis() > endTime )
-		{
-			break;
-		}
-
-    } // end while command
-
-} // end rainbow fade
-
-
+	return numberLeds;
+}
 
 /**
- * Creates random speckles of the specified color.
- *
- * 5-10 LEDs makes a nice effect
- *
- * NOTE: runTime has no effect at this time
+ * Sends the LED buffer to the LEDs; every segment is written from this call.
  *
+ * Skips the transfer if neither the buffer nor the intensity changed since
+ * the last frame sent.  A transfer runs with interrupts off, so every
+ * skipped frame is time given back to the WiFi stack.
  */
-void NeopixelWrapper::confetti(uint32_t duration, CRGB color, uint8_t fadeBy, uint32_t onTime, uint8_t hueUpdateTime)
+void NeopixelWrapper::show()
 {
-	uint8_t hue = 0;
-	uint32_t hueTime = 0;
-	uint32_t endTime = millis() + duration;;
-
-	resetIntensity(); // reset intensity to full
-	fill(BLACK, true); // clear any previous colors
+	uint32_t f;
+	uint32_t sum = 0;
 
-	while(isCommandAvailable() == false )
-    {
-        // random colored speckles that blink in and fade smoothly
-        fadeToBlackBy(leds, ledController->size(), fadeBy);
-        int pos = random16(ledController->size());
-        if (color == (CRGB)RAINBOW)
-        {
-            leds[pos] += CHSV(hue + random8(64), 200, 255);
-            // do some periodic updates
-            if( hueTime == hueUpdateTime )
-            {
-            	hueTime = 0;
-            	hue += 1;
-            }
-        }
-        else
-        {
-            leds[pos] += color;
-        }
-		show();
-//					FastLED.show();
-        commandDelay( onTime );
-        hueTime += 1;
-
-		if( duration > 0 && millis() > endTime )
-		{
-			break;
-		}
+	if( held )
+	{
+		showPending = true;
+		return;
+	}
 
-    } // end while command
+	compose();
+#ifdef MY_INDEXED_PIXELS
+	uint16_t level[PALETTE_SIZE];
 
-} // end confetti
+	f = fingerprint((uint8_t *)palette, sizeof(CRGB) * PALETTE_SIZE, 2166136261UL, &sum);
+	for(uint8_t i=0; i<PALETTE_SIZE; i++)
+	{
+		level[i] = palette[i].r + palette[i].g + palette[i].b;
+	}
+	sum = 0;
+	for(uint16_t i=0; i<numberLeds; i++)
+	{
+		f ^= indexes[i];
+		f *= 16777619UL;
+		sum += level[ indexes[i] ];
+	}
+#else
+	f = fingerprint((uint8_t *)output, sizeof(CRGB) * numberLeds, 2166136261UL, &sum);
+#endif
+	limitPower(sum);
 
+	// A dithered frame changes on the wire even if the pixels do not
+	if( frameValid && f == frameFingerprint && outputIntensity == frameIntensity && !isDithering() )
+	{
+		skippedFrames += 1;
+		return;
+	}
+	frameValid = true;
+	frameFingerprint = f;
+	frameIntensity = outputIntensity;
+	shownFrames += 1;
+
+#if defined(STAGED_OUTPUT)
+#ifdef MY_GAMMA_CORRECTION
+	if( lutIntensity != outputIntensity )
+	{
+		buildLut();
+	}
+	ditherFrame += 1;
+#endif
+	// Convert each segment into the scratch buffer just before it is sent
+	for(uint8_t i=0; i<numberSegments; i++)
+	{
+		stage(i);
+		segments[i].controller->showLeds(STAGE_INTENSITY);
+	}
+#elif defined(MY_PARALLEL_OUTPUT)
+	segments[0].controller->showLeds(outputIntensity);
+#else
+	for(uint8_t i=0; i<numberSegments; i++)
+	{
+		segments[i].controller->showLeds(outputIntensity);
+	}
+#endif
+//
+//	FastLED.show();
+}
 
+#ifdef STAGED_OUTPUT
 /**
- * Creates "cylon" pattern - bright led followed up dimming LEDs back and forth
- *
+ * Converts a segment into the scratch buffer: palette indexes are expanded
+ * and the gamma/intensity table applied.  Cycles spent are measured per
+ * pixel against STAGE_CYCLE_BUDGET.
  */
-void NeopixelWrapper::cylon(uint16_t repeat, uint32_t duration, CRGB color, uint32_t fadeTime, uint8_t fps, uint8_t hueUpdateTime)
+void NeopixelWrapper::stage(uint8_t segment)
 {
-	uint8_t hue = 0;
-	uint32_t hueTime = 0;
-	uint16_t count = 0;
-	uint32_t endTime = millis() + duration;;
-	uint8_t flag = false; // flag to increment counter
-
-	resetIntensity();
-	fill( BLACK, true);
-
-    while(isCommandAvailable() == false )
-    {
-        fadeToBlackBy(leds, ledController->size(), 20);
-        int pos = beatsin16(fps, 0, ledController->size());
-        if (color == (CRGB)RAINBOW)
-        {
-            leds[pos] += CHSV(hue, 255, 192);
-            if( hueTime == hueUpdateTime)
-            {
-            	hueTime = 0;
-            	hue +=1;
-            }
-        }
-        else
-        {
-            leds[pos] += color;
-        }
+	uint32_t cycles = ESP.getCycleCount();
+	uint16_t length = segments[segment].length;
+	CRGB color;
+#ifdef MY_INDEXED_PIXELS
+	uint8_t *src = indexes + segments[segment].start;
+#else
+	CRGB *src = output + segments[segment].start;
+#endif
+#ifdef MY_GAMMA_CORRECTION
+	uint8_t dither[2];
+
+	// Ordered temporal dither: the fraction threshold steps through eight
+	// levels frame by frame, alternating between neighbouring pixels
+#ifdef MY_TEMPORAL_DITHER
+	dither[0] = ((ditherFrame & 0x01) << 7 | (ditherFrame & 0x02) << 5 | (ditherFrame & 0x04) << 3) + 0x10;
+	dither[1] = dither[0] ^ 0x80;
+#else
+	dither[0] = 0x80;
+	dither[1] = 0x80;
+#endif
+#endif
 
-		show();
-//					FastLED.show();
-        commandDelay( fadeTime );
-        hueTime += 1;
+	for(uint16_t j=0; j<length; j++)
+	{
+#ifdef MY_INDEXED_PIXELS
+		color = palette[ src[j] ];
+#else
+		color = src[j];
+#endif
+#ifdef MY_GAMMA_CORRECTION
+		scratch[j].r = (lut[0][color.r] + dither[j & 0x01]) >> 8;
+		scratch[j].g = (lut[1][color.g] + dither[j & 0x01]) >> 8;
+		scratch[j].b = (lut[2][color.b] + dither[j & 0x01]) >> 8;
+#else
+		scratch[j] = color;
+#endif
+	}
 
-        if( pos == 0 && flag == false)
-        {
-			count += 1;
-			flag = true; // set flag
-        }
-        if( flag == true && pos != 0 )
-        {
-        	flag = false; // wait for beats to go past 0
-        }
-		if( repeat > 0 && count >= repeat )
+	if( length > 0 )
+	{
+		cycles = (ESP.getCycleCount() - cycles) / length;
+		stageCycles = cycles;
+		if( cycles > maxStageCycles )
 		{
-			break;
+			maxStageCycles = cycles;
 		}
-		if( duration > 0 && millis() > endTime )
+		if( cycles > STAGE_CYCLE_BUDGET )
 		{
-			break;
+			overBudgetFrames += 1;
 		}
+	}
+}
+#endif
 
-    } // end while command
-
-} // end cylon
-
+#ifdef MY_GAMMA_CORRECTION
 /**
- * No clue how to explain this one...
- *
+ * Builds the gamma curve as 8.8 fixed point; done once
  */
-void NeopixelWrapper::bpm(uint32_t duration, uint32_t onTime, uint8_t hueUpdateTime)
+void NeopixelWrapper::buildGamma()
 {
-	uint8_t hue = 0;
-	uint32_t hueTime = 0;
-	uint32_t endTime = millis() + duration;;
-
-	resetIntensity();
-	fill( BLACK, true);
-
-	while(isCommandAvailable() == false )
-    {
-        // colored stripes pulsing at a defined Beats-Per-Minute (BPM)
-        uint8_t BeatsPerMinute = 62;
-        CRGBPalette16 palette = PartyColors_p;
-        uint8_t beat = beatsin8(BeatsPerMinute, 64, 255);
-        for (int i = 0; i < ledController->size(); i++)
-        { //9948
-            leds[i] = ColorFromPalette(palette, hue + (i * 2), beat - hue + (i * 10));
-        }
-        if( hueTime == hueUpdateTime )
-        {
-        	hueTime = 0;
-        	hue +=1;
-        }
-
-		show();
-//					FastLED.show();
-        commandDelay( onTime );
-        hueTime += 1;
-
-		if( duration > 0 && millis() > endTime )
-		{
-			break;
-		}
-
-    }
-
+	for(uint16_t i=0; i<256; i++)
+	{
+		gamma[i] = (uint16_t)(powf(i / 255.0f, OUTPUT_GAMMA) * 65280.0f + 0.5f);
+	}
 }
 
 /**
- * No clue how to explain this one
- *
+ * Folds the white balance and the intensity into the gamma curve.  Only
+ * needs rebuilding when the intensity changes.
  */
-void NeopixelWrapper::juggle(uint32_t duration, uint32_t onTime)
+void NeopixelWrapper::buildLut()
 {
-	uint32_t endTime = millis() + duration;;
-
-	//TODO: Figure out to better control hue update time
+	uint32_t correction = MY_COLOR_CORRECTION;
+	uint16_t scale[3];
 
-	resetIntensity();
-	fill(BLACK, true);
-
-	while(isCommandAvailable() == false )
-    {
-        // eight colored dots, weaving in and out of sync with each other
-        fadeToBlackBy(leds, ledController->size(), 20);
-        byte dothue = 0;
-        for (int i = 0; i < 8; i++)
-        {
-            leds[beatsin16(i + 7, 0, ledController->size())] |= CHSV(dothue, 200, 255);
-            dothue += 32;
-        }
-
-		show();
-//					FastLED.show();
-        commandDelay( onTime );
+	// 8.8 scale per channel; full correction and intensity give exactly 256
+	for(uint8_t c=0; c<3; c++)
+	{
+		scale[c] = ((((correction >> (16 - 8*c)) & 0xFF) + 1) * ((uint16_t)outputIntensity + 1)) >> 8;
+	}
 
-		if( duration > 0 && millis() > endTime )
+	lutFraction = false;
+	for(uint16_t i=0; i<256; i++)
+	{
+		for(uint8_t c=0; c<3; c++)
 		{
-			break;
+			lut[c][i] = ((uint32_t)gamma[i] * scale[c]) >> 8;
+			lutFraction |= ((lut[c][i] & 0xFF) != 0);
 		}
-
-    }
+	}
+	lutIntensity = outputIntensity;
 }
+#endif
 
 /**
- * Stacks LEDs based on direction
- *
+ * Continues a FNV-1a hash over the bytes.  Also adds up the bytes; for
+ * the LED buffer that is the channel sum the power estimate needs.
  */
-void NeopixelWrapper::stack(uint16_t repeat, uint32_t duration, uint8_t direction, CRGB onColor, CRGB offColor, uint32_t onTime, uint8_t clearEnd)
+uint32_t NeopixelWrapper::fingerprint(uint8_t* p, uint16_t length, uint32_t hash, uint32_t* sum)
 {
-	uint8_t index;
-	uint16_t count;
-	uint32_t endTime;
-
-	resetIntensity();
-	fill(offColor, true);
-
-	count = 0;
-	endTime = millis() + duration;
+	uint8_t *end = p + length;
+	uint32_t total = 0;
 
-	while(isCommandAvailable() == false )
-    {
-
-		if( direction == DOWN )
-		{
-			index = 0;
-		}
-		else
-		{
-			index = ledController->size()-1;
-		}
+	while( p < end )
+	{
+		total += *p;
+		hash ^= *p++;
+		hash *= 16777619UL;
+	}
+	*sum += total;
+	return hash;
+}
 
-		for(uint8_t i=0; i<ledController->size(); i++ )
-		{
-			if(direction == DOWN )
-			{
-				for(int16_t j=ledController->size(); j>index; j -= 1 )
-				{
-					if( onColor == (CRGB)RAINBOW )
-					{
-						leds[j] = CHSV(random8(0, 255), 255, 255);
-					}
-					else
-					{
-						leds[j] = onColor;
-					}
-					show();
-//					FastLED.show();
-					if( commandDelay( onTime) ) return;
-					leds[j] = offColor;
-					show();
-//					FastLED.show();
-				}
-				if( onColor == (CRGB)RAINBOW )
-				{
-					leds[index] = CHSV(random8(0, 255), 255, 255);
-				}
-				else
-				{
-					leds[index] = onColor;
-				}
-				show();
-//					FastLED.show();
-				index += 1;
-			}
-			else if( direction == UP )
-			{
-				for(int16_t j=0; j<index; j += 1 )
-				{
-					if( onColor == (CRGB)RAINBOW )
-					{
-						leds[j] = CHSV(random8(0, 255), 255, 255);
-					}
-					else
-					{
-						leds[j] = onColor;
-					}
-					show();
-//					FastLED.show();
-					if( commandDelay( onTime) ) return;
-					leds[j] = offColor;
-					show();
-//					FastLED.show();
-				}
-				if( onColor == (CRGB)RAINBOW )
-				{
-					leds[index] = CHSV(random8(0, 255), 255, 255);
-				}
-				else
-				{
-					leds[index] = onColor;
-				}
-				show();
-//					FastLED.show();
-				index -= 1;
-			}
-		} // end for size
+/**
+ * Sets the intensity for the frame so the estimated draw stays within the
+ * power budget.  Every channel at 255 draws LED_CHANNEL_MA; each LED also
+ * draws LED_IDLE_MA when dark.
+ */
+void NeopixelWrapper::limitPower(uint32_t sum)
+{
+	uint32_t full = (sum * LED_CHANNEL_MA) / 255;	// at intensity 255
+	uint32_t idle = (uint32_t)numberLeds * LED_IDLE_MA;
+	uint32_t draw = (full * intensity) / 255 + idle;
 
-		if( clearEnd == true )
-		{
-			fill(offColor, true);
-		}
+	outputIntensity = intensity;
+	if( draw > powerPeak )
+	{
+		powerPeak = draw;
+	}
 
-		count += 1;
-		if( repeat > 0 && count >= repeat )
+	if( powerBudget > 0 && draw > powerBudget && full > 0 )
+	{
+		outputIntensity = (powerBudget > idle) ? ((powerBudget - idle) * 255) / full : 0;
+		if( outputIntensity > intensity )
 		{
-			break;
+			outputIntensity = intensity;
 		}
-
-		if( duration > 0 && millis() > endTime )
+		draw = (full * outputIntensity) / 255 + idle;
+		limitedFrames += 1;
+		if( intensity > 0 && (outputIntensity * 100) / intensity < powerScale )
 		{
-			break;
+			powerScale = (outputIntensity * 100) / intensity;
 		}
+	}
+	powerDraw = draw;
+}
 
+/**
+ * Sets the power budget in mA; 0 turns the limiter off
+ */
+void NeopixelWrapper::setPowerBudget(uint16_t mA)
+{
+	powerBudget = mA;
+}
 
-	} // end while command == false
+/**
+ * Returns the power budget in mA
+ */
+uint16_t NeopixelWrapper::getPowerBudget()
+{
+	return powerBudget;
+}
 
-} // end stack
+/**
+ * Returns the estimated draw of the last frame in mA, after limiting
+ */
+uint32_t NeopixelWrapper::getPowerDraw()
+{
+	return powerDraw;
+}
 
 /**
- * Randomly fills string with specified color
- *
+ * Returns the highest draw in mA the frames asked for since the counters
+ * were reset, before limiting; what the supply would have needed
  */
-void NeopixelWrapper::fillRandom(uint16_t repeat, uint32_t duration, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime, uint8_t clearAfter, uint8_t clearEnd)
+uint32_t NeopixelWrapper::getPowerPeak()
 {
-	uint8_t total;
-	uint8_t index;
-	uint16_t count;
-	uint32_t endTime;
-	uint8_t flag = false;
+	return powerPeak;
+}
 
-	resetIntensity();
-	fill(offColor, true);
+/**
+ * Returns the lowest intensity scale in percent the limiter applied since
+ * the counters were reset; 100 if it never had to
+ */
+uint8_t NeopixelWrapper::getPowerScale()
+{
+	return powerScale;
+}
 
-	count = 0;
-	endTime = millis() + duration;
+/**
+ * Returns the number of frames the limiter dimmed
+ */
+uint32_t NeopixelWrapper::getLimitedFrames()
+{
+	return limitedFrames;
+}
 
-	CRGB color = onColor;
+#ifdef MY_INDEXED_PIXELS
+/**
+ * Returns the palette entry for the color, adding it if there is room.
+ * A full palette gives the closest entry.
+ */
+uint8_t NeopixelWrapper::paletteIndex(CRGB color)
+{
+	uint8_t best = 0;
+	uint16_t bestDistance = 0xFFFF;
+	uint16_t distance;
 
-	while(isCommandAvailable() == false )
-    {
-		total = ledController->size();
-		while( total > 0 )
-		{
-			index = random8(0, ledController->size());
-			if( onColor == (CRGB)RAINBOW )
-			{
-				color = CHSV(random8(0, 255), 255, 255);
-			}
-			if( leds[index] == offColor || flag == true )
-			{
-				leds[index] = color;
-				show();
-//					FastLED.show();
-				total--;
-				if( commandDelay(onTime)) return;
-				if( clearAfter )
-				{
-					leds[index] = offColor;
-					if( commandDelay(offTime)) return;
-				}
-			}
-		}
-		flag = true;
-		if( clearEnd )
+	for(uint8_t i=0; i<paletteUsed; i++)
+	{
+		if( palette[i] == color )
 		{
-			fill(offColor, true);
-			flag = false;
+			return i;
 		}
+	}
 
-		count += 1;
-		if( repeat > 0 && count >= repeat )
-		{
-			break;
-		}
+	if( paletteUsed < PALETTE_SIZE )
+	{
+		palette[paletteUsed] = color;
+		return paletteUsed++;
+	}
 
-		if( duration > 0 && millis() > endTime )
+	for(uint8_t i=0; i<PALETTE_SIZE; i++)
+	{
+		distance = abs(palette[i].r - color.r) + abs(palette[i].g - color.g) + abs(palette[i].b - color.b);
+		if( distance < bestDistance )
 		{
-			break;
+			best = i;
+			bestDistance = distance;
 		}
+	}
+	return best;
+}
+#endif
 
-	} // while command == false
+/**
+ * Holds back show() until releaseShow(), so several changes reach the
+ * LEDs as one frame
+ */
+void NeopixelWrapper::holdShow()
+{
+	held = true;
+}
 
+/**
+ * Ends holdShow(); shows the LEDs if a show was held back
+ */
+void NeopixelWrapper::releaseShow()
+{
+	held = false;
+	if( showPending )
+	{
+		showPending = false;
+		show();
+	}
+}
 
-} // end randomFill
+/**
+ * Clears the shown and skipped frame counters
+ */
+void NeopixelWrapper::resetFrameCounters()
+{
+	shownFrames = 0;
+	skippedFrames = 0;
+	powerPeak = 0;
+	powerScale = 100;
+	limitedFrames = 0;
+}
 
+/**
+ * Returns the number of frames sent to the LEDs
+ */
+uint32_t NeopixelWrapper::getShownFrames()
+{
+	return shownFrames;
+}
 
-////////////////////////////////////////
-// BEGIN PRIVATE FUNCTIONS
-////////////////////////////////////////
 /**
- * Sets the color of the specified LED for onTime time.  If clearAfter
- * is true, returns color to original color and waits offTime before returning.
+ * Returns the number of frames skipped because nothing changed
  */
-void NeopixelWrapper::setPatternTimed(int16_t startIndex, uint8_t pattern, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime, uint8_t clearAfter)
+uint32_t NeopixelWrapper::getSkippedFrames()
 {
-	CRGB currentColor[8];
+	return skippedFrames;
+}
 
-	for(uint8_t i=0; i<8; i++)
-	{
-		if(startIndex+i < ledController->size() && startIndex+i >= 0)
-		{
-			currentColor[i] = leds[startIndex+i];
-		}
-	}
-	setPattern(startIndex, 8, pattern, 8, onColor, offColor, true);
-    commandDelay(onTime);
+/**
+ * Prints the frame counters
+ */
+void NeopixelWrapper::dumpFrames()
+{
+	Serial.print(F("Frames shown: "));
+	Serial.print(shownFrames);
+	Serial.print(F(", skipped: "));
+	Serial.println(skippedFrames);
+	Serial.print(F("Power peak(mA): "));
+	Serial.print(powerPeak);
+	Serial.print(F(", last(mA): "));
+	Serial.print(powerDraw);
+	Serial.print(F(", limited: "));
+	Serial.print(limitedFrames);
+	Serial.print(F(", min scale: "));
+	Serial.print(powerScale);
+	Serial.println(F("%"));
+#ifdef STAGED_OUTPUT
+	Serial.print(F("Stage cycles/pixel: "));
+	Serial.print(stageCycles);
+	Serial.print(F(", max: "));
+	Serial.print(maxStageCycles);
+	Serial.print(F(", over budget: "));
+	Serial.println(overBudgetFrames);
+#endif
+}
 
-    if(clearAfter == true)
-    {
-    	for(uint8_t i=0; i<8; i++)
-    	{
-    		if(startIndex+i < ledController->size() && startIndex+i >= 0)
-    		{
-        		leds[startIndex+i] = currentColor[i];
-    		}
-    	}
-		show();
-//					FastLED.show();
-        commandDelay(offTime);
-    }
+/**
+ * Returns the hue update time
+ */
+uint8_t NeopixelWrapper::getIntensity()
+{
+	return intensity;
+//	return FastLED.getBrightness();
 }
 
+/**
+ * Changes the amount of time to wait before updating the hue
+ *
+ */
+void NeopixelWrapper::setIntensity(uint8_t i)
+{
+	intensity = i;
+//	FastLED.setBrightness(i);
+}
 
 /**
- * Sets the color of the specified LED for onTime time.  If clearAfter
- * is true, returns color to original color and waits offTime before returning.
+ * fills all pixels with specified color
+ *
+ * @color - color to set
+ * @show - if true, sets color immediately
  */
-void NeopixelWrapper::setPixelTimed(int16_t index, CRGB newColor, uint32_t onTime, uint32_t offTime, uint8_t clearAfter)
+void NeopixelWrapper::fill(CRGB color, uint8_t s)
 {
-    CRGB curColor;
+	resetIntensity();
 
-    curColor = leds[index];
-    leds[index] = newColor;
-	show();
-//					FastLED.show();
-    commandDelay(onTime);
-    if(clearAfter == true)
+#ifdef MY_INDEXED_PIXELS
+	// every pixel is overwritten, so the palette starts over
+	paletteUsed = 0;
+	memset(indexes, paletteIndex(color), size());
+#else
+	for (uint16_t i = 0; i < size(); i++)
     {
-        leds[index] = curColor;
-		show();
-//					FastLED.show();
-        commandDelay(offTime);
+        leds[i] = color;
+    }
+#endif
+    layers[target].dirty = true;
+    if (s)
+    {
+    	show();
+//        FastLED.show();
     }
-
 }
 
+/**
+ * Fills pixels with specified pattern, starting at 0. 1 = on, 0 = off.
+ *
+ * Repeats pattern every 8 pixels.
+ *
+ */
+void NeopixelWrapper::fillPattern(uint8_t pattern, CRGB onColor, CRGB offColor)
+{
+	resetIntensity();
+	setPattern(0, size(), pattern, 8, onColor, offColor, true);
+}
 
 /**
  * Fills the pixels with the specified pattern, starting at the specified index.
  * Stops filling when length is hit.
  *
  */
-void NeopixelWrapper::setPattern(int16_t startIndex, uint8_t length, uint8_t pattern, uint8_t patternLength, CRGB onColor, CRGB offColor, uint8_t s)
+void NeopixelWrapper::setPattern(int16_t startIndex, uint16_t length, uint8_t pattern, uint8_t patternLength, CRGB onColor, CRGB offColor, uint8_t s)
 {
     int16_t index;
     uint8_t patternIndex = 0;
+#ifdef MY_INDEXED_PIXELS
+    uint8_t onIndex;
+    uint8_t offIndex;
+
+    // a pattern over the whole strip replaces every pixel
+    if( startIndex <= 0 && startIndex + length >= size() )
+    {
+    	paletteUsed = 0;
+    }
+    onIndex = paletteIndex(onColor);
+    offIndex = paletteIndex(offColor);
+#endif
 
 #ifdef __DEBUG
     	Serial.print(F("setPattern(start="));
@@ -1481,10 +1311,8 @@ void NeopixelWrapper::setPattern(int16_t startIndex, uint8_t length, uint8_t pat
 
     for(index=0; index<length; index++)
     {
-    	worker();
-
     	// Safety measure - allows pattern length to be > amount of pixels left
-		if( (startIndex+index) >= ledController->size())
+		if( (startIndex+index) >= size())
 		{
 #ifdef __DEBUG
     	Serial.print(F("WARN - pixel["));
@@ -1509,7 +1337,11 @@ void NeopixelWrapper::setPattern(int16_t startIndex, uint8_t length, uint8_t pat
 			// rotates pattern and tests for "on"
 			if ((pattern >> patternIndex) & 0x01)
 			{
+#ifdef MY_INDEXED_PIXELS
+				indexes[startIndex+index] = onIndex;
+#else
 				leds[startIndex+index] = onColor;
+#endif
 #ifdef __DEBUG
 			Serial.print(F("INFO - pixel["));
 			Serial.print(startIndex+index);
@@ -1519,7 +1351,11 @@ void NeopixelWrapper::setPattern(int16_t startIndex, uint8_t length, uint8_t pat
 			}
 			else
 			{
+#ifdef MY_INDEXED_PIXELS
+				indexes[startIndex+index] = offIndex;
+#else
 				leds[startIndex+index] = offColor;
+#endif
 #ifdef __DEBUG
 			Serial.print(F("INFO - pixel["));
 			Serial.print(startIndex+index);
@@ -1538,6 +1374,7 @@ void NeopixelWrapper::setPattern(int16_t startIndex, uint8_t length, uint8_t pat
         }
 
     } // end for
+    layers[target].dirty = true;
 
     if( s )
     {
@@ -1547,29 +1384,6 @@ void NeopixelWrapper::setPattern(int16_t startIndex, uint8_t length, uint8_t pat
 
 }
 
-/**
- * Sets the color of the specified LED.
- */
-void NeopixelWrapper::setPixel(int16_t index, CRGB color)
-{
-	if( index <0 || index >= ledController->size() )
-	{
-	    leds[index] = color;
-	}
-	else
-	{
-#ifdef __DEBUG
-    	Serial.print(F("WARN - pixel["));
-    	Serial.print(index);
-    	Serial.print(F("]="));
-    	Serial.print(color, HEX);
-    	Serial.println(F("-SKIPPING"));
-#endif
-	}
-	Helper::workYield(); // Give time to ESP
-
-}
-
 /**
  * If current intensity is 0, reset to default
  *
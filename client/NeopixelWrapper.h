@@ -38,69 +38,204 @@
 #define DEFAULT_FPS 		120
 #define DEFAULT_INTENSITY	200
 
+#define MAX_NUMBER_SEGMENTS	4
+
+// Wire time of one WS2812 pixel (24 bits at 1.25us) and of the latch, in us
+#define LED_PIXEL_TIME		30
+#define LED_LATCH_TIME		50
+
+// Current draw of one WS2812 channel at full brightness and of a dark LED, in mA
+#define LED_CHANNEL_MA		20
+#define LED_IDLE_MA			1
+
+#define PALETTE_SIZE		16
+
+#define TRANSITION_INTERVAL	10	// ms between crossfade frames when nothing else draws
+#define DITHER_INTERVAL		10	// ms between dither frames of a static scene
+
+// Segments pass through a scratch buffer on their way out
+#if defined(MY_INDEXED_PIXELS) || defined(MY_GAMMA_CORRECTION)
+#define STAGED_OUTPUT
+#endif
+
+#if defined(STAGED_OUTPUT) && defined(MY_PARALLEL_OUTPUT)
+#error "Indexed pixels and gamma correction stage each segment; not supported with parallel output"
+#endif
+
+#define OUTPUT_GAMMA		2.2f
+#define STAGE_CYCLE_BUDGET	40	// CPU cycles per pixel for the output stage
+
+// The gamma table carries white balance and intensity itself
+#ifdef MY_GAMMA_CORRECTION
+#define OUTPUT_CORRECTION	UncorrectedColor
+#define STAGE_INTENSITY		255
+#else
+#define OUTPUT_CORRECTION	MY_COLOR_CORRECTION
+#define STAGE_INTENSITY		outputIntensity
+#endif
+#if defined(MY_INDEXED_PIXELS) && MY_NUMBER_SEGMENTS < 2
+#error "Indexed pixels with one segment stage the whole strip as RGB and save no memory; use several segments"
+#endif
+
+#define NUMBER_LAYERS		3
+#define LAYER_BASE			0	// the effect; always present
+#define LAYER_OVERLAY		1	// drawn over the effect
+#define LAYER_NOTIFY		2	// drawn over everything
+
+#define BLEND_REPLACE		0	// lit pixels replace what is below
+#define BLEND_ADD			1	// saturating add
+#define BLEND_MAX			2	// brightest channel wins
+#define BLEND_ALPHA			3	// lit pixels mixed in by the layer alpha
+
+/**
+ * One layer of the frame; black pixels of an overlay are transparent
+ */
+typedef struct
+{
+	CRGB* pixels;
+	uint8_t blend;
+	uint8_t alpha;
+	uint8_t dirty;
+} Layer;
+
+/**
+ * One physical output; drives length LEDs of the logical buffer from start
+ */
+typedef struct
+{
+	uint8_t pin;
+	uint16_t start;
+	uint16_t length;
+	CLEDController* controller;
+} Segment;
+
 class NeopixelWrapper
 {
 public:
 	NeopixelWrapper();
-	boolean initialize(uint8_t numLeds, uint8_t intensity);
+	boolean initialize(uint16_t numLeds, uint8_t intensity);
 
 	void setFramesPerSecond(uint8_t fps);
 	uint8_t getFramesPerSecond();
 
 	void setIntensity(uint8_t i);
 	uint8_t getIntensity();
+	void resetIntensity();
+
+	CRGB* getLeds();
+	uint16_t size();
+	uint8_t isIndexed();
+
+	uint8_t enableLayer(uint8_t layer, uint8_t blend, uint8_t alpha);
+	void disableLayer(uint8_t layer);
+	uint8_t selectLayer(uint8_t layer);
+	uint8_t isLayerEnabled(uint8_t layer);
+	CRGB* getLayer(uint8_t layer);
+	void markDirty(uint8_t layer);
+
+	uint8_t startTransition(uint32_t time);
+	uint8_t isTransitioning();
+	void endTransition();
+	uint8_t isDithering();
+
+	uint8_t getNumberSegments();
+	Segment* getSegment(uint8_t segment);
+	uint32_t getFrameTime();
+	uint16_t getMaxFramesPerSecond();
 
 	void show();
+	void holdShow();
+	void releaseShow();
+	void resetFrameCounters();
+	uint32_t getShownFrames();
+	uint32_t getSkippedFrames();
+	void dumpFrames();
+
+	void setPowerBudget(uint16_t mA);
+	uint16_t getPowerBudget();
+	uint32_t getPowerDraw();
+	uint32_t getPowerPeak();
+	uint8_t getPowerScale();
+	uint32_t getLimitedFrames();
 
 	CRGB getPixel(int16_t index);
 	void setPixel(int16_t index, CRGB color, uint8_t show);
+	uint16_t setPixels(uint16_t start, const uint8_t* rgb, uint16_t count, uint8_t show);
     void fill(CRGB color, uint8_t show);
     void fillPattern(uint8_t pattern, CRGB onColor, CRGB offColor);
-
-    void wipe(uint16_t repeat, uint32_t duration, uint8_t direction, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime, uint8_t clearAfter, uint8_t clearEnd);
-    void rotatePattern(uint16_t repeat, uint32_t duration, uint8_t pattern, uint8_t direction, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime);
-    void scrollPattern(uint16_t repeat, uint32_t duration, uint8_t pattern, uint8_t patternLength, uint8_t direction, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime, uint8_t clearAfter, uint8_t clearEnd);
-    void bounce(uint16_t repeat, uint32_t duration, uint8_t pattern, uint8_t patternLength, uint8_t direction, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime, uint32_t bounceTime, uint8_t clearAfter, uint8_t clearEnd);
-    void middle(uint16_t repeat, uint32_t duration, uint8_t direction, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime, uint8_t clearAfter, uint8_t clearEnd);
-    void randomFlash(uint16_t repeat, uint32_t duration, uint32_t onTime, uint32_t offTime, CRGB onColor, CRGB offColor, uint8_t number);
-    void fade(uint8_t direction, uint8_t fadeIncrement, uint32_t time, CRGB color);
-    void strobe(uint16_t repeat, uint32_t duration, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime );
-    void lightning(uint16_t repeat, uint32_t duration, CRGB onColor, CRGB offColor);
-
-    void stack(uint16_t repeat, uint32_t duration, uint8_t direction, CRGB onColor, CRGB offColor, uint32_t onTime, uint8_t clearEnd);
-    void fillRandom(uint16_t repeat, uint32_t duration, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime, uint8_t clearAfter, uint8_t clearEnd);
-
-    void rainbow(uint32_t duration, uint8_t glitterProbability, CRGB glitterColor, uint32_t onTime, uint8_t hueUpdateTime);
-    void rainbowFade(uint32_t duration, uint32_t onTime);
-	void confetti(uint32_t duration, CRGB color, uint8_t fadeBy, uint32_t onTime, uint8_t hueUpdateTime);
-	void cylon(uint16_t repeat, uint32_t duration, CRGB color, uint32_t fadeTime, uint8_t fps, uint8_t hueUpdateTime);
-	void bpm(uint32_t duration, uint32_t onTime, uint8_t hueUpdateTime);
-	void juggle(uint32_t duration, uint32_t onTime );
+	void setPattern(int16_t startIndex, uint16_t length, uint8_t pattern, uint8_t patternLength, CRGB onColor, CRGB offColor, uint8_t show);
 
 protected:
 	CRGB *leds;
+	CRGB *output;
+	CRGB *snapshot;
+	uint32_t transitionStart;
+	uint32_t transitionTime;
 	uint8_t intensity;
-	void setPixel(int16_t index, CRGB color);
-	void setPatternTimed(int16_t index, uint8_t pattern, CRGB onColor, CRGB offColor, uint32_t onTime, uint32_t offTime, uint8_t clearAfter);
-	void setPixelTimed(int16_t index, CRGB newColor, uint32_t onTime, uint32_t offTime, uint8_t clearAfter);
-	void setPattern(int16_t startIndex, uint8_t length, uint8_t pattern, uint8_t patternLength, CRGB onColor, CRGB offColor, uint8_t show);
+	uint16_t numberLeds;
+	uint16_t bufferSize;
+	uint8_t target;
+	Layer layers[NUMBER_LAYERS];
+	uint8_t numberSegments;
+	Segment segments[MAX_NUMBER_SEGMENTS];
+
+	uint8_t frameValid;
+	uint8_t frameIntensity;
+	uint32_t frameFingerprint;
+	uint32_t shownFrames;
+	uint32_t skippedFrames;
+	uint8_t held;
+	uint8_t showPending;
+
+	uint16_t powerBudget;
+	uint8_t outputIntensity;
+	uint32_t powerDraw;
+	uint32_t powerPeak;
+	uint8_t powerScale;
+	uint32_t limitedFrames;
+
+	uint32_t fingerprint(uint8_t* p, uint16_t length, uint32_t hash, uint32_t* sum);
+	void limitPower(uint32_t sum);
+
+#ifdef STAGED_OUTPUT
+	CRGB *scratch;
+	uint32_t stageCycles;
+	uint32_t maxStageCycles;
+	uint32_t overBudgetFrames;
+
+	void stage(uint8_t segment);
+#endif
 
-	void resetIntensity();
+#ifdef MY_GAMMA_CORRECTION
+	uint16_t gamma[256];
+	uint16_t lut[3][256];
+	uint8_t lutIntensity;
+	uint8_t lutFraction;	// the table has bits below the output
+	uint8_t ditherFrame;
 
+	void buildGamma();
+	void buildLut();
+#endif
 
-};
+#ifdef MY_INDEXED_PIXELS
+	uint8_t *indexes;
+	CRGB palette[PALETTE_SIZE];
+	uint8_t paletteUsed;
 
-//end of add your includes here
-#ifdef __cplusplus
-extern "C"
-{
+	uint8_t paletteIndex(CRGB color);
 #endif
 
-extern uint8_t isCommandAvailable();
-extern uint8_t commandDelay(uint32_t time);
+	void layout(uint16_t numLeds);
+	CLEDController* addSegment(uint8_t segment);
+	uint8_t separateOutput();
+	void releaseOutput();
+	void attachOutput(CRGB* buffer);
+	void compose();
+	void crossfade(uint16_t weight);
+	void dumpLayout();
 
-#ifdef __cplusplus
-} // extern "C"
-#endif
+};
+
+//end of add your includes here
 
 #endif /* NEOPIXELWRAPPER_H_ */
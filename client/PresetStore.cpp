@@ -0,0 +1,153 @@
+/*
+ * PresetStore.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#include "PresetStore.h"
+
+/**
+ * Constructor
+ */
+PresetStore::PresetStore()
+{
+	for(uint8_t i=0; i<PRESET_SLOTS; i++)
+	{
+		lengths[i] = 0;
+	}
+	dirty = false;
+	lastChange = 0;
+}
+
+/**
+ * Builds the index from flash; slots that fail their CRC are empty.
+ * EEPROM must already be started by the configuration.
+ *
+ */
+void PresetStore::initialize()
+{
+	const uint8_t* data = EEPROM.getConstDataPtr();
+	uint16_t length;
+	int a;
+
+	for(uint8_t i=0; i<PRESET_SLOTS; i++)
+	{
+		a = address(i);
+		length = data[a] | (data[a+1] << 8);
+		lengths[i] = 0;
+		if( length > 0 && length <= PRESET_MAX_LENGTH &&
+			Configuration::computeChecksum(data + a + PRESET_HEADER_SIZE, length) == data[a+2] )
+		{
+			lengths[i] = length;
+		}
+	}
+}
+
+/**
+ * Stores a message as preset id; a length of 0 erases the preset.
+ * Returns false if the id is out of range or the message too large or
+ * not a command.
+ *
+ */
+uint8_t PresetStore::store(uint8_t id, const uint8_t* message, uint16_t length, uint32_t now)
+{
+	Command cmd;
+	int a;
+
+	if( id >= PRESET_SLOTS )
+	{
+		Serial.println(F("ERROR - bad preset id"));
+		return false;
+	}
+	if( length > PRESET_MAX_LENGTH )
+	{
+		Serial.println(F("ERROR - preset too large"));
+		return false;
+	}
+
+	// Presets that play presets could loop
+	if( length > 0 && ( message[0] == PRESET_TRIGGER || !cmd.parse((uint8_t *)message, length) ||
+		cmd.getCommand() == CMD_STORE_PRESET || cmd.getCommand() == CMD_PLAY_PRESET ) )
+	{
+		Serial.println(F("ERROR - preset is not a command"));
+		return false;
+	}
+
+	// The EEPROM cache only marks bytes that change, so storing the same
+	// preset again does not wear the flash
+	a = address(id);
+	EEPROM.write(a, length & 0xFF);
+	EEPROM.write(a+1, (length >> 8) & 0xFF);
+	EEPROM.write(a+2, Configuration::computeChecksum(message, length));
+	for(uint16_t i=0; i<length; i++)
+	{
+		EEPROM.write(a + PRESET_HEADER_SIZE + i, message[i]);
+	}
+
+	lengths[id] = length;
+	dirty = true;
+	lastChange = now;
+
+	Serial.print(F("Preset stored: "));
+	Serial.print(id);
+	Serial.print(F(", "));
+	Serial.print(length);
+	Serial.println(F(" bytes"));
+
+	return true;
+}
+
+/**
+ * Returns preset id and sets its length, or returns 0 if there is none.
+ * The message stays in the EEPROM cache; it must not be changed.
+ *
+ */
+const uint8_t* PresetStore::get(uint8_t id, uint16_t* length)
+{
+	if( id >= PRESET_SLOTS || lengths[id] == 0 )
+	{
+		return 0;
+	}
+
+	*length = lengths[id];
+	return EEPROM.getConstDataPtr() + address(id) + PRESET_HEADER_SIZE;
+}
+
+/**
+ * Writes stored presets to flash once no more arrived for a while
+ *
+ */
+void PresetStore::work(uint32_t now)
+{
+	if( dirty && (now - lastChange) >= PRESET_COMMIT_DELAY )
+	{
+		dirty = false;
+		if( !EEPROM.commit() )
+		{
+			Serial.println(F("ERROR - failed to commit presets to flash"));
+		}
+	}
+}
+
+/**
+ * Prints the preset index
+ */
+void PresetStore::dump()
+{
+	Serial.print(F("Presets -"));
+	for(uint8_t i=0; i<PRESET_SLOTS; i++)
+	{
+		Serial.print(F(" "));
+		Serial.print( lengths[i] );
+	}
+	Serial.println( dirty ? F(" (not committed)") : F("") );
+}
+
+/**
+ * Returns the flash address of a preset slot
+ */
+int PresetStore::address(uint8_t id)
+{
+	return PRESET_START_ADDRESS + id*PRESET_SLOT_SIZE;
+}
@@ -0,0 +1,56 @@
+/*
+ * PresetStore.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#ifndef PRESETSTORE_H_
+#define PRESETSTORE_H_
+
+#include <Arduino.h>
+#include <EEPROM.h>
+
+#include "ClientGlobal.h"
+#include "Configuration.h"
+#include "Command.h"
+
+// Slot layout: length(2, little endian) crc(1) message
+#define PRESET_HEADER_SIZE		3
+#define PRESET_MAX_LENGTH		(PRESET_SLOT_SIZE - PRESET_HEADER_SIZE)
+
+// Changes are written to flash once none were made for this long (ms)
+#define PRESET_COMMIT_DELAY		5000
+
+/**
+ * Keeps command messages in flash, after the configuration, so the
+ * controller can replay a look with a two byte trigger instead of
+ * resending it.  A preset is any message the node accepts: a command, a
+ * batch or a program load.
+ *
+ * The slot lengths are indexed in RAM when the store starts, so finding a
+ * preset is an array lookup; the message is read straight from the
+ * EEPROM cache.  Stores only change the cache and are committed once the
+ * controller has been quiet for PRESET_COMMIT_DELAY, so a burst of stores
+ * costs one flash write.
+ */
+class PresetStore
+{
+public:
+	PresetStore();
+	void initialize();
+
+	uint8_t store(uint8_t id, const uint8_t* message, uint16_t length, uint32_t now);
+	const uint8_t* get(uint8_t id, uint16_t* length);
+	void work(uint32_t now);
+	void dump();
+
+protected:
+	uint16_t lengths[PRESET_SLOTS]; // 0 = empty
+	uint8_t dirty;
+	uint32_t lastChange;
+
+	int address(uint8_t id);
+};
+
+#endif /* PRESETSTORE_H_ */
@@ -0,0 +1,95 @@
+/*
+ * Program.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#include "Program.h"
+
+/**
+ * Constructor
+ */
+Program::Program()
+{
+	code[0] = OP_END;
+	length = 0;
+	version = 0;
+}
+
+/**
+ * Loads the program carried by a CMD_LOAD_PROGRAM message; cmd is the
+ * parsed message and tells where the program sits in the payload.
+ * Returns false if there is no program or it is too large.
+ *
+ */
+uint8_t Program::load(const uint8_t* payload, uint16_t length, Command* cmd)
+{
+	const uint8_t* p = payload + cmd->getProgramStart();
+	uint16_t size = cmd->getProgramLength();
+	uint16_t n;
+
+	if( cmd->getProgramStart() == 0 || cmd->getProgramStart() + size > length )
+	{
+		Serial.println(F("ERROR - no program"));
+		return false;
+	}
+
+	if( payload[0] == BINARY_VERSION )
+	{
+		n = size;
+		if( n > PROGRAM_SIZE )
+		{
+			Serial.println(F("ERROR - program too large"));
+			return false;
+		}
+		memcpy(code, p, n);
+	}
+	else
+	{
+		JsonReader r(p, size, 0);
+		n = r.readArray(code, PROGRAM_SIZE);
+		if( !r.isValid() )
+		{
+			// Partly overwritten; make sure nothing runs what is left
+			Serial.println(F("ERROR - bad program"));
+			this->length = 0;
+			code[0] = OP_END;
+			version += 1;
+			return false;
+		}
+	}
+
+	this->length = n;
+	version += 1;
+
+	Serial.print(F("Program loaded: "));
+	Serial.print(n);
+	Serial.println(F(" bytes"));
+
+	return true;
+}
+
+/**
+ * Returns the bytecode
+ */
+const uint8_t* Program::getCode()
+{
+	return code;
+}
+
+/**
+ * Returns the length of the bytecode
+ */
+uint16_t Program::getLength()
+{
+	return length;
+}
+
+/**
+ * Returns the load count; changes when a new program is loaded
+ */
+uint16_t Program::getVersion()
+{
+	return version;
+}
@@ -0,0 +1,76 @@
+/*
+ * Program.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#ifndef PROGRAM_H_
+#define PROGRAM_H_
+
+#include <Arduino.h>
+
+#include "ClientGlobal.h"
+#include "Command.h"
+
+// Largest program that can be loaded (bytes)
+#define PROGRAM_SIZE		256
+
+// Instructions run per frame before the frame is ended regardless
+#define PROGRAM_FRAME_BUDGET	256
+
+#define PROGRAM_REGISTERS	8
+
+// Instruction set.  Opcodes are one byte; r operands are one byte register
+// numbers, imm32 is 4 bytes and addr/imm16 are 2 bytes, little endian.
+// Colors are 0xRRGGBB.  Times are ms since the program started.
+#define OP_END			0x00	// end the program
+#define OP_SET			0x01	// r, imm32		r = imm32
+#define OP_MOV			0x02	// rd, rs		rd = rs
+#define OP_ADD			0x03	// rd, rs		rd += rs
+#define OP_SUB			0x04	// rd, rs		rd -= rs
+#define OP_ADDI			0x05	// rd, imm16	rd += (int16)imm16
+#define OP_MOD			0x06	// rd, rs		rd %= rs (unchanged if rs is 0)
+#define OP_RAND			0x07	// rd, rs		rd = random below rs (any 16 bit if rs is 0)
+#define OP_HSV			0x08	// rd, rh, rs, rv	rd = color of hue, saturation, value
+#define OP_SCALE		0x09	// rd, rs		rd = color rd scaled by rs/256
+#define OP_TIME			0x0A	// rd			rd = program time
+#define OP_LEN			0x0B	// rd			rd = number of LEDs
+#define OP_FILL			0x10	// rc			fill with color
+#define OP_PIXEL		0x11	// ri, rc		set pixel
+#define OP_RANGE		0x12	// ri, rn, rc	set rn pixels from ri
+#define OP_PATTERN		0x13	// rp, ron, roff	fill with pattern
+#define OP_FADE			0x14	// rs			fade all pixels by rs/256
+#define OP_SHOW			0x18	// 				end the frame
+#define OP_WAIT			0x19	// rt			end the frame, next one rt ms later
+#define OP_WAIT_UNTIL	0x1A	// rt			end the frame, next one at program time rt
+#define OP_JMP			0x20	// addr			jump
+#define OP_JNZ			0x21	// r, addr		jump if r != 0
+#define OP_LOOP			0x22	// r, addr		decrement r, jump if r != 0
+#define OP_JLT			0x23	// ra, rb, addr	jump if ra < rb
+
+/**
+ * Holds the bytecode program run by CMD_RUN_PROGRAM.
+ *
+ * A program is loaded once by CMD_LOAD_PROGRAM, as a JSON array of bytes
+ * or as the program field of a binary command, and then runs on the node
+ * without any further messages.  The version changes on every load so a
+ * running program restarts with the new code.
+ */
+class Program
+{
+public:
+	Program();
+
+	uint8_t load(const uint8_t* payload, uint16_t length, Command* cmd);
+	const uint8_t* getCode();
+	uint16_t getLength();
+	uint16_t getVersion();
+
+protected:
+	uint8_t code[PROGRAM_SIZE];
+	uint16_t length;
+	uint16_t version;
+};
+
+#endif /* PROGRAM_H_ */
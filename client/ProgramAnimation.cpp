@@ -0,0 +1,315 @@
+/*
+ * ProgramAnimation.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#include "ProgramAnimation.h"
+
+/**
+ * Constructor
+ */
+ProgramAnimation::ProgramAnimation()
+{
+	program = 0;
+	code = 0;
+	length = 0;
+	version = 0;
+	pc = 0;
+	fault = false;
+	startTime = 0;
+	overruns = 0;
+	for(uint8_t i=0; i<PROGRAM_REGISTERS; i++)
+	{
+		reg[i] = 0;
+	}
+}
+
+/**
+ * Sets the program store to run from
+ */
+void ProgramAnimation::setProgram(Program* program)
+{
+	this->program = program;
+}
+
+void ProgramAnimation::begin(uint32_t now)
+{
+	start(now);
+	overruns = 0;
+	if( program == 0 || program->getLength() == 0 )
+	{
+		Serial.println(F("ERROR - no program loaded"));
+		stop();
+		return;
+	}
+	reset(now);
+}
+
+uint32_t ProgramAnimation::step(uint32_t now)
+{
+	uint32_t a;
+	uint32_t b;
+	uint16_t addr;
+	uint8_t op;
+
+	// A new program was loaded while running; start it from the top
+	if( program->getVersion() != version )
+	{
+		reset(now);
+	}
+
+	if( started && isExpired(now) )
+	{
+		stop();
+		return 0;
+	}
+	started = true;
+
+	for(uint16_t budget=PROGRAM_FRAME_BUDGET; budget>0; budget--)
+	{
+		op = fetch();
+		if( fault )
+		{
+			Serial.println(F("ERROR - program ran off its end"));
+			stop();
+			return 0;
+		}
+
+		switch( op )
+		{
+		case OP_END:
+			if( cmd->getRepeat() == 0 || nextCycle(now) )
+			{
+				stop();
+				return 0;
+			}
+			pc = 0;
+			break;
+		case OP_SET:
+		{
+			uint32_t& d = fetchRegister();
+			d = fetch32();
+			break;
+		}
+		case OP_MOV:
+		{
+			uint32_t& d = fetchRegister();
+			d = fetchRegister();
+			break;
+		}
+		case OP_ADD:
+		{
+			uint32_t& d = fetchRegister();
+			d += fetchRegister();
+			break;
+		}
+		case OP_SUB:
+		{
+			uint32_t& d = fetchRegister();
+			d -= fetchRegister();
+			break;
+		}
+		case OP_ADDI:
+		{
+			uint32_t& d = fetchRegister();
+			d += (int16_t)fetch16();
+			break;
+		}
+		case OP_MOD:
+		{
+			uint32_t& d = fetchRegister();
+			a = fetchRegister();
+			if( a != 0 )
+			{
+				d %= a;
+			}
+			break;
+		}
+		case OP_RAND:
+		{
+			uint32_t& d = fetchRegister();
+			a = fetchRegister();
+			d = (a == 0) ? random16() : random16() % a;
+			break;
+		}
+		case OP_HSV:
+		{
+			uint32_t& d = fetchRegister();
+			uint8_t h = fetchRegister();
+			uint8_t s = fetchRegister();
+			uint8_t v = fetchRegister();
+			CRGB c = CHSV(h, s, v);
+			d = ((uint32_t)c.r << 16) | ((uint32_t)c.g << 8) | c.b;
+			break;
+		}
+		case OP_SCALE:
+		{
+			uint32_t& d = fetchRegister();
+			CRGB c(d);
+			c.nscale8( fetchRegister() );
+			d = ((uint32_t)c.r << 16) | ((uint32_t)c.g << 8) | c.b;
+			break;
+		}
+		case OP_TIME:
+			fetchRegister() = now - startTime;
+			break;
+		case OP_LEN:
+			fetchRegister() = controller->size();
+			break;
+		case OP_FILL:
+			controller->fill( CRGB(fetchRegister()), false );
+			break;
+		case OP_PIXEL:
+			a = fetchRegister();
+			controller->setPixel( a, CRGB(fetchRegister()), false );
+			break;
+		case OP_RANGE:
+		{
+			a = fetchRegister();
+			b = fetchRegister();
+			CRGB c( fetchRegister() );
+			for(uint32_t i=a; i<a+b && i<controller->size(); i++)
+			{
+				controller->setPixel( i, c, false );
+			}
+			break;
+		}
+		case OP_PATTERN:
+		{
+			a = fetchRegister();
+			b = fetchRegister();
+			controller->fillPattern( a, CRGB(b), CRGB(fetchRegister()) );
+			break;
+		}
+		case OP_FADE:
+			fadeToBlackBy( leds, controller->size(), fetchRegister() );
+			break;
+		case OP_SHOW:
+			return frameInterval();
+		case OP_WAIT:
+			return fetchRegister();
+		case OP_WAIT_UNTIL:
+			a = fetchRegister() - (now - startTime);
+			return ( (int32_t)a > 0 ) ? a : 0;
+		case OP_JMP:
+			pc = fetch16();
+			break;
+		case OP_JNZ:
+			a = fetchRegister();
+			addr = fetch16();
+			if( a != 0 )
+			{
+				pc = addr;
+			}
+			break;
+		case OP_LOOP:
+		{
+			uint32_t& d = fetchRegister();
+			addr = fetch16();
+			d -= 1;
+			if( d != 0 )
+			{
+				pc = addr;
+			}
+			break;
+		}
+		case OP_JLT:
+			a = fetchRegister();
+			b = fetchRegister();
+			addr = fetch16();
+			if( (int32_t)a < (int32_t)b )
+			{
+				pc = addr;
+			}
+			break;
+		default:
+			Serial.print(F("ERROR - bad opcode "));
+			Serial.println(op, HEX);
+			stop();
+			return 0;
+		}
+
+		if( fault )
+		{
+			Serial.println(F("ERROR - program ran off its end"));
+			stop();
+			return 0;
+		}
+	}
+
+	// Out of budget; show what is there and carry on next frame
+	overruns += 1;
+	return frameInterval();
+}
+
+/**
+ * Reports frames that ran out of instruction budget
+ */
+void ProgramAnimation::finish()
+{
+	if( overruns > 0 )
+	{
+		Serial.print(F("Program - frames over budget: "));
+		Serial.println(overruns);
+	}
+}
+
+/**
+ * Starts the current program from the top with cleared registers
+ */
+void ProgramAnimation::reset(uint32_t now)
+{
+	code = program->getCode();
+	length = program->getLength();
+	version = program->getVersion();
+	pc = 0;
+	fault = false;
+	startTime = now;
+	for(uint8_t i=0; i<PROGRAM_REGISTERS; i++)
+	{
+		reg[i] = 0;
+	}
+}
+
+/**
+ * Returns the next byte of the program; flags a fault past the end
+ */
+uint8_t ProgramAnimation::fetch()
+{
+	if( pc >= length )
+	{
+		fault = true;
+		return OP_END;
+	}
+	return code[pc++];
+}
+
+uint16_t ProgramAnimation::fetch16()
+{
+	uint16_t v = fetch();
+	return v | ((uint16_t)fetch() << 8);
+}
+
+uint32_t ProgramAnimation::fetch32()
+{
+	uint32_t v = fetch16();
+	return v | ((uint32_t)fetch16() << 16);
+}
+
+/**
+ * Returns the register named by the next byte of the program
+ */
+uint32_t& ProgramAnimation::fetchRegister()
+{
+	return reg[ fetch() % PROGRAM_REGISTERS ];
+}
+
+/**
+ * Returns the time between frames at the command's frame rate (ms)
+ */
+uint32_t ProgramAnimation::frameInterval()
+{
+	return (cmd->getFramesPerSecond() > 0) ? 1000 / cmd->getFramesPerSecond() : 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * ProgramAnimation.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#ifndef PROGRAMANIMATION_H_
+#define PROGRAMANIMATION_H_
+
+#include <Arduino.h>
+#include <FastLed.h>
+
+#include "ClientGlobal.h"
+#include "Animation.h"
+#include "Program.h"
+
+/**
+ * Runs the loaded bytecode program as an animation.
+ *
+ * Each step interprets instructions until the program ends a frame with
+ * SHOW or WAIT, so a program renders at full frame rate without any
+ * parsing.  A frame runs at most PROGRAM_FRAME_BUDGET instructions; a
+ * program that runs over is shown as far as it got and resumes on the
+ * next frame, which keeps a runaway loop from starving the network.
+ *
+ * END finishes the program, or starts it over while the command's repeat
+ * count is not reached.  The command's duration also ends it.
+ */
+class ProgramAnimation : public Animation
+{
+public:
+	ProgramAnimation();
+	void setProgram(Program* program);
+
+	void begin(uint32_t now);
+	uint32_t step(uint32_t now);
+	void finish();
+
+protected:
+	Program* program;
+	const uint8_t* code;
+	uint16_t length;
+	uint16_t version;
+	uint16_t pc;
+	uint8_t fault;
+	uint32_t reg[PROGRAM_REGISTERS];
+	uint32_t startTime;
+	uint32_t overruns;
+
+	void reset(uint32_t now);
+	uint8_t fetch();
+	uint16_t fetch16();
+	uint32_t fetch32();
+	uint32_t& fetchRegister();
+	uint32_t frameInterval();
+};
+
+#endif /* PROGRAMANIMATION_H_ */
@@ -15,7 +15,23 @@ void pause(uint32_t time);
 PubSubWrapper::PubSubWrapper()
 {
 	config = 0;
+	wifi = 0;
+	state = MQTT_STATE_WAITING;
+	backoff = MQTT_BACKOFF_MIN;
+	nextAttempt = 0;
+	reconnects = 0;
 	cmdBuf = 0;
+	for(uint8_t i=0; i<RELAY_SLOTS; i++)
+	{
+		relays[i].buffer = 0;
+		relays[i].length = 0;
+		relays[i].due = 0;
+		relays[i].pending = false;
+	}
+	program = 0;
+	stream = 0;
+	metrics = 0;
+	queue.setClock(&clock);
 }
 
 /**
@@ -24,7 +40,10 @@ PubSubWrapper::PubSubWrapper()
 uint8_t PubSubWrapper::initialize(Configuration* config, WifiWrapper* wifi)
 {
 	this->config = config;
+	this->wifi = wifi;
+	wifi->getWifiClient().setTimeout(MQTT_CONNECT_TIMEOUT);
 	pubsub.setClient( (Client &)wifi->getWifiClient() );
+	pubsub.setSocketTimeout(MQTT_ACK_TIMEOUT);
 
 	// Check if we are connected - if so, disconnect
 	if( pubsub.connected() )
@@ -51,13 +70,28 @@ uint8_t PubSubWrapper::initialize(Configuration* config, WifiWrapper* wifi)
 		Serial.println(F("ERROR - unable to allocate json buffer memory!"));
 		return false;
 	}
+	for(uint8_t i=0; i<RELAY_SLOTS; i++)
+	{
+		if( relays[i].buffer == 0 )
+		{
+			relays[i].buffer = (uint8_t *)malloc(CMD_BUFFER_SIZE);
+			if( relays[i].buffer == 0 )
+			{
+				Serial.println(F("ERROR - unable to allocate relay buffer memory!"));
+				return false;
+			}
+		}
+		relays[i].pending = false;
+	}
+	presets.initialize();
 	Helper::workYield(); // Give time to ESP
 
 	return connect();
 }
 
 /**
- * Connects to MQTT to server
+ * Connects to MQTT to server.  Blocks for up to getMqttTries() attempts;
+ * only used at start up, later connection losses are handled by work().
  *
  */
 uint8_t PubSubWrapper::connect()
@@ -68,6 +102,7 @@ uint8_t PubSubWrapper::connect()
 	if( pubsub.connected() )
 	{
 		Serial.println(F("Queue connected."));
+		flag = true;
 	}
 	else
 	{
@@ -76,39 +111,26 @@ uint8_t PubSubWrapper::connect()
 		// Loop until we're reconnected or "timeout"
 		while( count < config->getMqttTries() )
 		{
-			// Attempt to connect
-			if (pubsub.connect((char *)config->getMyChannel()))
+			if( attempt() )
 			{
-				Helper::workYield(); // Give time to ESP
-				Serial.println(F("SUCCESS!"));
-
-				// subscribe to channels
-				pubsub.subscribe( (char *)config->getAllChannel() );
-				pubsub.subscribe( (char *)config->getMyChannel() );
-
-				// Once connected, publish an announcement...
-				Serial.print(F("Announcing presence: "));
-				Serial.println( (char *)config->getMyChannel() );
-
-				// Tell controller we're listening
-				pubsub.publish((char *)config->getRegistrationChannel(), (char *)config->getMyChannel() );
-
 				flag = true;
 				break;
 			}
-			else
-			{
-				Serial.print(F("."));
 
-				// Wait 500 ms before retrying
-				Helper::delayYield(500);
-			}
+			Serial.print(F("."));
+
+			// Wait 500 ms before retrying
+			Helper::delayYield(500);
 			count += 1;
 
 		} // end while
 	}
 
-	if( !flag )
+	if( flag )
+	{
+		state = MQTT_STATE_CONNECTED;
+	}
+	else
 	{
 		Serial.println(F("\n**ERROR - unable to bind to queue."));
 	}
@@ -116,6 +138,85 @@ uint8_t PubSubWrapper::connect()
 	return flag;
 }
 
+/**
+ * Makes one connection attempt; announces the node if it succeeds
+ *
+ */
+uint8_t PubSubWrapper::attempt()
+{
+	if( !pubsub.connect((char *)config->getMyChannel()) )
+	{
+		return false;
+	}
+
+	Serial.println(F("SUCCESS!"));
+	announce();
+
+	return true;
+}
+
+/**
+ * Subscribes and tells the controller we're listening, in one go so the
+ * controller never sees a node it cannot reach yet
+ *
+ */
+void PubSubWrapper::announce()
+{
+	pubsub.subscribe( (char *)config->getAllChannel() );
+	pubsub.subscribe( (char *)config->getMyChannel() );
+	pubsub.publish( (char *)config->getRegistrationChannel(), (char *)config->getMyChannel() );
+
+	Serial.print(F("Announced presence: "));
+	Serial.println( (char *)config->getMyChannel() );
+}
+
+/**
+ * Gets the connection back without holding up the frame loop between
+ * attempts: one attempt per call at most, the first as soon as the loss
+ * is seen and the rest further and further apart.  The attempt itself
+ * blocks for up to MQTT_CONNECT_TIMEOUT plus MQTT_ACK_TIMEOUT.  Attempts
+ * are jittered so a broker restart is not met by every node at once.
+ *
+ */
+void PubSubWrapper::reconnect(uint32_t now)
+{
+	switch( state )
+	{
+	case MQTT_STATE_CONNECTED:
+		if( pubsub.connected() )
+		{
+			return;
+		}
+		Serial.println(F("Queue connection lost"));
+		state = MQTT_STATE_WAITING;
+		backoff = MQTT_BACKOFF_MIN;
+		nextAttempt = now;
+		break;
+
+	case MQTT_STATE_WAITING:
+		if( (int32_t)(now - nextAttempt) < 0 || !wifi->connected() )
+		{
+			return;
+		}
+
+		Serial.print(F("Attempting queue reconnection..."));
+		if( attempt() )
+		{
+			state = MQTT_STATE_CONNECTED;
+			reconnects += 1;
+			return;
+		}
+
+		// Anywhere in the upper half of the backoff
+		nextAttempt = millis() + backoff/2 + random(backoff/2 + 1);
+		Serial.print(F("failed; next in "));
+		Serial.print( nextAttempt - millis() );
+		Serial.println(F(" ms"));
+		backoff = min( backoff*2, (uint32_t)MQTT_BACKOFF_MAX );
+		break;
+	}
+}
+
 /**
  * Disconnects from MQTT server
  *
@@ -147,39 +248,73 @@ uint8_t PubSubWrapper::connected()
 	return pubsub.connected();
 }
 
+/**
+ * Returns the number of times the connection was lost and regained
+ */
+uint32_t PubSubWrapper::getReconnects()
+{
+	return reconnects;
+}
+
 /**
  * Checks if we still have a valid connection to the server.
- * If there is no connection, an attempt will be made.
+ * If there is no connection, an attempt is made when one is due.
  *
  */
 uint8_t PubSubWrapper::checkConnection()
 {
-	uint8_t flag = pubsub.connected();
+	reconnect( millis() );
+	return pubsub.connected();
+}
+
+/**
+ * Calls the loop function to process queue messages
+ *
+ */
+void PubSubWrapper::work()
+{
+	uint32_t now;
+	uint32_t start = micros();
 
-	if (!flag)
+	pubsub.loop();
+	if( metrics != 0 )
 	{
-//		Serial.println("ERROR - Queue not connected; Attempting to reconnect...");
-		flag = connect();
-//		if( flag )
-//		{
-//			Serial.println("Reconnection successful.");
-//		}
-//		else
-//		{
-//			Serial.println("Reconnection failed.");
-//		}
+		metrics->recordLoop( micros() - start );
 	}
 
-	return flag;
+	now = millis();
+	reconnect(now);
+	if( pubsub.connected() && clock.isPingDue(now) )
+	{
+		sync(now);
+	}
+
+	forwardDue(now);
+
+	presets.work(now);
+	if( stream != 0 )
+	{
+		stream->work(now);
+	}
 }
 
 /**
- * Calls the loop function to process queue messages
+ * Pings the controller on the response channel for its time; the reply
+ * arrives on our channel and is handled by the callback
  *
  */
-void PubSubWrapper::work()
+void PubSubWrapper::sync(uint32_t now)
 {
-	pubsub.loop();
+	Command ping;
+
+	ping.setCommand(CMD_SYNC);
+	ping.setNodeId( config->getNodeId() );
+	ping.setSyncOrigin(now);
+	if( ping.buildSync(cmdBuf) )
+	{
+		pubsub.publish( (char *)config->getMyResponseChannel(), (char *)cmdBuf );
+	}
+	clock.pingSent(now);
 }
 
 
@@ -191,6 +326,8 @@ void PubSubWrapper::work()
  */
 void PubSubWrapper::callback(char* topic, byte* payload, unsigned int length)
 {
+	uint32_t now = millis(); // receive time for clock sync replies
+
 #ifdef __DEBUG
 	Serial.print( millis() );
 	Serial.print(F(" - Message arrived ["));
@@ -204,19 +341,289 @@ void PubSubWrapper::callback(char* topic, byte* payload, unsigned int length)
 #endif
 
 
-	if( length <= CMD_BUFFER_SIZE )
+	// Frames are drawn as they arrive and never buffered; a range is
+	// bound by MQTT_PACKET_SIZE like every other message
+	if( length > 0 && payload[0] == FRAME_VERSION )
 	{
-		// Copy payload to command buffer
-		memcpy( (void *)cmdBuf, (void *)payload, length);
-		Helper::workYield(); // Give time to ESP
+		if( stream != 0 )
+		{
+			stream->receive(payload, length, now);
+		}
+		return;
+	}
+
+	if( length > CMD_BUFFER_SIZE )
+	{
+		Serial.println(F("ERROR - command buffer too small"));
+		return;
+	}
+
+	// Triggers skip the parser altogether
+	if( length == 2 && payload[0] == PRESET_TRIGGER )
+	{
+		play(payload[1], now);
+		return;
+	}
+
+	// Drop copies of a command before parsing it
+	uint32_t uid = Command::peekUniqueId(payload, length);
+	if( seen.isDuplicate(uid, now) )
+	{
+		Serial.print(F("Duplicate command dropped: "));
+		Serial.println(uid);
+		return;
+	}
+
+	dispatch(payload, length, now, true);
+}
+
+/**
+ * Parses a message and queues its commands.  Presets are dispatched the
+ * same way but were seen before, so their uid is not remembered.
+ *
+ */
+void PubSubWrapper::dispatch(uint8_t* payload, unsigned int length, uint32_t now, uint8_t remember)
+{
+	// Parse in place; the payload is only valid during the callback
+	Command* cmd = queue.reserve();
+	uint32_t start = micros();
+	uint8_t parsed = cmd->parse(payload, length);
+	if( metrics != 0 )
+	{
+		metrics->recordParse( micros() - start );
+	}
+	if( parsed )
+	{
+		cmd->setReceiveTime(now);
+		if( remember )
+		{
+			seen.add(cmd->getUniqueId(), now);
+		}
+
+		// Sync replies are timed on arrival, not queued
+		if( cmd->getCommand() == CMD_SYNC )
+		{
+			clock.sample( cmd->getSyncOrigin(), cmd->getSyncTime(), now );
+			return;
+		}
+
+		// Programs are stored as they arrive; the command is still queued
+		// so it completes in order
+		if( cmd->getCommand() == CMD_LOAD_PROGRAM && (program == 0 || !program->load(payload, length, cmd)) )
+		{
+			return;
+		}
+
+		// Same for presets
+		if( cmd->getCommand() == CMD_STORE_PRESET &&
+			!presets.store(cmd->getNumber(), payload + cmd->getPresetStart(), cmd->getPresetLength(), now) )
+		{
+			return;
+		}
+
+		// The preset takes the place of the play command
+		if( cmd->getCommand() == CMD_PLAY_PRESET )
+		{
+			play(cmd->getNumber(), now);
+			return;
+		}
+
+		// Keep the payload before queueing reuses the slot; it is
+		// forwarded after, since publishing overwrites the receive buffer
+		if( cmd->getRelay() == RELAY_ON_RECEIPT && cmd->getRelayNodeSize() > 0 )
+		{
+			holdRelay(cmd, payload, length, now);
+		}
+
+		if( cmd->getBatchStart() > 0 )
+		{
+			queueBatch(cmd, payload, length);
+		}
+		else
+		{
+			queue.commit();
+		}
 
-		setCommandAvailable(true);
+		forwardDue(now);
 	}
 	else
 	{
-		Serial.println(F("ERROR - command buffer too small"));
+		Serial.println(F("ERROR - unable to parse command"));
+	}
+
+}
+
+/**
+ * Handles stored preset id as if its message just arrived
+ *
+ */
+void PubSubWrapper::play(uint8_t id, uint32_t now)
+{
+	uint16_t length;
+	const uint8_t* message = presets.get(id, &length);
+
+	if( message == 0 )
+	{
+		Serial.print(F("ERROR - no preset "));
+		Serial.println(id);
+		return;
+	}
+
+	// Read in place; parsing does not change the message
+	dispatch((uint8_t *)message, length, now, false);
+}
+
+/**
+ * Queues the commands of a batch message back to back.  The batch uid,
+ * node, priority, execute time and atomic flag apply to every command; only the last
+ * one notifies on completion, so the batch completes once.
+ *
+ */
+void PubSubWrapper::queueBatch(Command* header, uint8_t* payload, unsigned int length)
+{
+	Command batch = *header; // the header's slot is reused for the first command
+	uint8_t* list = payload + batch.getBatchStart();
+	uint16_t size = length - batch.getBatchStart();
+	const uint8_t* element;
+	uint16_t elementLength;
+	uint8_t count = 0;
+	Command check;
+	Command* cmd;
+	Command* last = 0;
+
+	// Count and check first; a batch is queued whole or not at all
+	JsonReader counter(list, size, '[');
+	while( counter.nextElement(&element, &elementLength) )
+	{
+		if( !check.parse((uint8_t *)element, elementLength) )
+		{
+			Serial.println(F("ERROR - unable to parse batch command"));
+			return;
+		}
+		count += 1;
+	}
+	if( !counter.isValid() || count == 0 )
+	{
+		Serial.println(F("ERROR - bad batch"));
+		return;
+	}
+	if( !queue.reserveBatch(count) )
+	{
+		return;
+	}
+
+	JsonReader r(list, size, '[');
+	while( r.nextElement(&element, &elementLength) )
+	{
+		// Checked above, so this cannot fail
+		cmd = queue.reserve();
+		cmd->parse((uint8_t *)element, elementLength);
+
+		cmd->setUniqueId( batch.getUniqueId() );
+		cmd->setReceiveTime( batch.getReceiveTime() );
+		if( cmd->getNodeId() == 0 )
+		{
+			cmd->setNodeId( batch.getNodeId() );
+		}
+		cmd->setPriority( batch.getPriority() );
+		cmd->setPreempt( last == 0 ? batch.getPreempt() : cmd->getPreempt() );
+		cmd->setAtomic( batch.getAtomic() );
+		cmd->setExecuteAt( batch.getExecuteAt() );
+		cmd->setNotifyOnComplete(false);
+		cmd->setBatch(BATCH_MEMBER);
+		queue.commit();
+		last = cmd;
+	}
+
+	if( last != 0 )
+	{
+		last->setNotifyOnComplete( batch.getNotifyOnComplete() );
+		last->setBatch(BATCH_LAST);
+	}
+}
+
+/**
+ * Keeps a command relayed on receipt until it is forwarded, now or after
+ * its relay offset.  Up to RELAY_SLOTS relays wait at once; when all are
+ * taken the one due first is forwarded early to make room, so the nodes
+ * below this one never miss a command.
+ *
+ */
+void PubSubWrapper::holdRelay(Command* cmd, uint8_t* payload, unsigned int length, uint32_t now)
+{
+	uint8_t slot = RELAY_SLOTS;
+
+	for(uint8_t i=0; i<RELAY_SLOTS; i++)
+	{
+		if( !relays[i].pending )
+		{
+			slot = i;
+			break;
+		}
+		if( slot == RELAY_SLOTS || (int32_t)(relays[i].due - relays[slot].due) < 0 )
+		{
+			slot = i;
+		}
+	}
+	if( relays[slot].pending )
+	{
+		Serial.println(F("Relays full; forwarding early"));
+		forward(slot);
+	}
+
+	memcpy(relays[slot].buffer, payload, length);
+	relays[slot].length = length;
+	relays[slot].cmd = *cmd;
+	relays[slot].due = now + cmd->getRelayOffset();
+	relays[slot].pending = true;
+}
+
+/**
+ * Forwards the held relays whose offset passed
+ *
+ */
+void PubSubWrapper::forwardDue(uint32_t now)
+{
+	for(uint8_t i=0; i<RELAY_SLOTS; i++)
+	{
+		if( relays[i].pending && (int32_t)(now - relays[i].due) >= 0 )
+		{
+			forward(i);
+		}
 	}
+}
 
+/**
+ * Forwards a held command to the first nodes of its relay tree.  Each
+ * copy is the received payload with the node id and relay list patched.
+ *
+ */
+void PubSubWrapper::forward(uint8_t slot)
+{
+	Relay* relay = &relays[slot];
+	char channel[STRING_SIZE];
+	uint8_t dest;
+	uint8_t first;
+	uint8_t size;
+	uint16_t length;
+
+	relay->pending = false;
+	for(uint8_t i=0; relay->cmd.getRelayChild(i, &dest, &first, &size); i++)
+	{
+		length = relay->cmd.buildRelay(relay->buffer, relay->length, dest, first, size, cmdBuf);
+		if( dest == 0 || length == 0 )
+		{
+			Serial.println(F("ERROR - unable to relay command"));
+			continue;
+		}
+
+		memset(channel, 0, STRING_SIZE);
+		sprintf((char *)channel, DEFAULT_CHANNEL_MY, dest );
+		Serial.print( millis() );
+		Serial.print(F(" - Relaying to: "));
+		Serial.println( dest );
+		publish(channel, cmdBuf, length);
+	}
 }
 
 /**
@@ -239,6 +646,16 @@ void PubSubWrapper::publish(char *channel, char *buffer)
 	pubsub.publish(channel, buffer);
 }
 
+/**
+ * Publishes a message of the given length; binary payloads are not
+ * terminated
+ *
+ */
+void PubSubWrapper::publish(char *channel, uint8_t* buffer, uint16_t length)
+{
+	pubsub.publish(channel, buffer, length);
+}
+
 /**
  * Publishes a message to the specified channel
  *
@@ -258,3 +675,66 @@ uint8_t* PubSubWrapper::getBuffer()
 {
 	return cmdBuf;
 }
+
+/**
+ * Returns the queue of commands received
+ *
+ */
+CommandQueue* PubSubWrapper::getQueue()
+{
+	return &queue;
+}
+
+/**
+ * Returns the cache of recently seen command ids
+ *
+ */
+UidCache* PubSubWrapper::getSeen()
+{
+	return &seen;
+}
+
+/**
+ * Returns the presets stored in flash
+ *
+ */
+PresetStore* PubSubWrapper::getPresets()
+{
+	return &presets;
+}
+
+/**
+ * Sets the store programs are loaded into
+ *
+ */
+void PubSubWrapper::setProgram(Program* program)
+{
+	this->program = program;
+}
+
+/**
+ * Sets the counters message handling is recorded in
+ *
+ */
+void PubSubWrapper::setMetrics(Metrics* metrics)
+{
+	this->metrics = metrics;
+}
+
+/**
+ * Sets the stream frames are drawn by
+ *
+ */
+void PubSubWrapper::setStream(FrameStream* stream)
+{
+	this->stream = stream;
+}
+
+/**
+ * Returns the clock shared with the controller
+ *
+ */
+ClockSync* PubSubWrapper::getClock()
+{
+	return &clock;
+}
@@ -13,8 +13,53 @@
 #include "ClientGlobal.h"
 #include "Configuration.h"
 #include "WifiWrapper.h"
+#include "ClockSync.h"
 #include "Command.h"
+#include "CommandQueue.h"
+#include "UidCache.h"
 #include "Helper.h"
+#include "Program.h"
+#include "PresetStore.h"
+#include "FrameStream.h"
+#include "Metrics.h"
+
+// Reconnect states
+#define MQTT_STATE_CONNECTED	0
+#define MQTT_STATE_WAITING		1	// for the next attempt
+
+// Wait between reconnect attempts (ms); doubles on every failure
+#define MQTT_BACKOFF_MIN		500
+#define MQTT_BACKOFF_MAX		30000
+
+// A connect attempt still blocks the frame loop: for the TCP connection
+// (ms) and then for the broker's CONNACK (s; PubSubClient counts whole
+// seconds).  An attempt on a dead broker stalls a frame by up to 1.5 s,
+// once per backoff; a live broker answers in a few ms.
+#define MQTT_CONNECT_TIMEOUT	500
+#define MQTT_ACK_TIMEOUT		1
+
+// PubSubClient drops any message larger than its packet buffer without a
+// word.  Commands, responses and stream ranges all fit the command
+// buffer; add the MQTT fixed header (up to 5), topic length and topic.
+#define MQTT_PACKET_SIZE		(CMD_BUFFER_SIZE + 5 + 2 + STRING_SIZE)
+#if MQTT_MAX_PACKET_SIZE < MQTT_PACKET_SIZE
+#error "MQTT_MAX_PACKET_SIZE is smaller than MQTT_PACKET_SIZE (539); raise it in PubSubClient.h"
+#endif
+
+// Commands relayed on receipt that may wait for their relay offset at once
+#define RELAY_SLOTS				3
+
+/**
+ * A command relayed on receipt, held until its relay offset passed
+ */
+typedef struct
+{
+	uint8_t* buffer;	// the message as received
+	uint16_t length;
+	uint32_t due;
+	uint8_t pending;
+	Command cmd;
+} Relay;
 
 class PubSubWrapper
 {
@@ -27,19 +72,52 @@ public:
 	uint8_t disconnect();
 	uint8_t checkConnection();
 	uint8_t connected();
+	uint32_t getReconnects();
 
 	void work();
 	void publish(char *channel);
 	void publish( char *channel, char* buffer);
 	void publish( char *channel, JsonObject& obj);
+	void publish( char *channel, uint8_t* buffer, uint16_t length);
 	uint8_t *getBuffer();
+	CommandQueue* getQueue();
+	ClockSync* getClock();
+	UidCache* getSeen();
+	PresetStore* getPresets();
+	void setProgram(Program* program);
+	void setStream(FrameStream* stream);
+	void setMetrics(Metrics* metrics);
 
 
 protected:
 	PubSubClient pubsub;
 	Configuration* config;
+	WifiWrapper* wifi;
+	uint8_t state;
+	uint32_t backoff;
+	uint32_t nextAttempt;
+	uint32_t reconnects;
 	uint8_t* cmdBuf;
+	Relay relays[RELAY_SLOTS];
+	CommandQueue queue;
+	ClockSync clock;
+	UidCache seen;
+	PresetStore presets;
+	Program* program;
+	FrameStream* stream;
+	Metrics* metrics;
 
+	uint8_t attempt();
+	void announce();
+	void reconnect(uint32_t now);
+	void sync(uint32_t now);
+	void dispatch(uint8_t* payload, unsigned int length, uint32_t now, uint8_t remember);
+	void play(uint8_t id, uint32_t now);
+	void holdRelay(Command* cmd, uint8_t* payload, unsigned int length, uint32_t now);
+	void forward(uint8_t slot);
+	void forwardDue(uint32_t now);
+
+	void queueBatch(Command* header, uint8_t* payload, unsigned int length);
 };
 
 
@@ -49,10 +127,6 @@ extern "C"
 {
 #endif
 
-extern uint8_t isCommandAvailable();
-extern void setCommandAvailable(uint8_t b);
-extern uint8_t commandDelay(uint32_t time);
-
 extern void pubsubCallback(char* topic, byte* payload, unsigned int length);
 
 #ifdef __cplusplus
@@ -76,16 +76,5 @@ protected:
 };
 
 //end of add your includes here
-#ifdef __cplusplus
-extern "C"
-{
-#endif
-
-extern uint8_t isCommandAvailable();
-extern uint8_t commandDelay(uint32_t time);
-
-#ifdef __cplusplus
-} // extern "C"
-#endif
 
 #endif /* STATUSINDICATOR_H_ */
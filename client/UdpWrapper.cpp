@@ -0,0 +1,416 @@
+/*
+ * UdpWrapper.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#include "UdpWrapper.h"
+
+/**
+ * Constructor
+ */
+UdpWrapper::UdpWrapper()
+{
+	controller = 0;
+	universes = 0;
+	received = 0;
+	sequenced = 0;
+	for(uint8_t i=0; i<UDP_MAX_UNIVERSES; i++)
+	{
+		sequences[i] = 0;
+	}
+	ddpSequence = 0;
+	drawn = false;
+	active = false;
+	firstPacket = 0;
+	lastPacket = 0;
+	frameStart = 0;
+	packets = 0;
+	frames = 0;
+	stale = 0;
+	latency = 0;
+	maxLatency = 0;
+}
+
+/**
+ * Opens the sockets; the LEDs must be initialized.  Returns false if a
+ * socket could not be opened.
+ *
+ */
+uint8_t UdpWrapper::initialize(NeopixelWrapper* controller)
+{
+	this->controller = controller;
+
+	universes = (controller->size() + UDP_UNIVERSE_PIXELS - 1) / UDP_UNIVERSE_PIXELS;
+	if( universes > UDP_MAX_UNIVERSES )
+	{
+		Serial.println(F("ERROR - too many LEDs for UDP; the rest are not reachable"));
+		universes = UDP_MAX_UNIVERSES;
+	}
+
+	if( !e131.begin(UDP_E131_PORT) || !artnet.begin(UDP_ARTNET_PORT) || !ddp.begin(UDP_DDP_PORT) )
+	{
+		Serial.println(F("ERROR - unable to open UDP ports"));
+		return false;
+	}
+
+	Serial.print(F("UDP universes: "));
+	Serial.print(MY_UDP_UNIVERSE);
+	Serial.print(F("-"));
+	Serial.println(MY_UDP_UNIVERSE + universes - 1);
+
+	return true;
+}
+
+/**
+ * Reads the packets waiting on the sockets and ends a stream that went
+ * silent
+ *
+ */
+void UdpWrapper::work()
+{
+	uint32_t hold = (MY_UDP_HOLD_TIME > 0) ? MY_UDP_HOLD_TIME : UDP_STREAM_TIMEOUT;
+	int length;
+
+	if( controller == 0 )
+	{
+		return;
+	}
+
+	for(uint8_t i=0; i<UDP_MAX_PACKETS && (length = e131.parsePacket()) > 0; i++)
+	{
+		receiveE131(length);
+	}
+	for(uint8_t i=0; i<UDP_MAX_PACKETS && (length = artnet.parsePacket()) > 0; i++)
+	{
+		receiveArtNet(length);
+	}
+	for(uint8_t i=0; i<UDP_MAX_PACKETS && (length = ddp.parsePacket()) > 0; i++)
+	{
+		receiveDdp(length);
+	}
+
+	if( active && (millis() - lastPacket) >= hold )
+	{
+		end(MY_UDP_HOLD_TIME > 0);
+	}
+}
+
+/**
+ * Returns true while a sender is streaming
+ */
+uint8_t UdpWrapper::isActive()
+{
+	return active;
+}
+
+/**
+ * Handles an E1.31 packet
+ */
+void UdpWrapper::receiveE131(uint16_t length)
+{
+	uint16_t universe;
+	uint16_t count;
+
+	if( length < E131_HEADER_SIZE || e131.read(header, E131_HEADER_SIZE) != E131_HEADER_SIZE )
+	{
+		return;
+	}
+
+	// Only DMX data with the null start code; no previews
+	if( header[E131_ROOT_VECTOR+3] != 0x04 || header[E131_FRAME_VECTOR+3] != 0x02 ||
+		header[E131_DMP_VECTOR] != 0x02 || header[E131_START_CODE] != 0x00 ||
+		(header[E131_OPTIONS] & E131_OPTION_PREVIEW) )
+	{
+		return;
+	}
+
+	if( header[E131_OPTIONS] & E131_OPTION_TERMINATED )
+	{
+		if( active )
+		{
+			end(MY_UDP_HOLD_TIME > 0);
+		}
+		return;
+	}
+
+	universe = (header[E131_UNIVERSE] << 8) | header[E131_UNIVERSE+1];
+	if( accept(universe, header[E131_SEQUENCE]) )
+	{
+		count = ((header[E131_COUNT] << 8) | header[E131_COUNT+1]) - 1;
+		draw(e131, universe - MY_UDP_UNIVERSE, min(count, (uint16_t)(length - E131_HEADER_SIZE)));
+	}
+}
+
+/**
+ * Handles an Art-Net packet
+ */
+void UdpWrapper::receiveArtNet(uint16_t length)
+{
+	uint16_t opcode;
+	uint16_t universe;
+	uint16_t count;
+
+	if( length < ARTNET_OPCODE + 2 || artnet.read(header, min(length, (uint16_t)ARTNET_HEADER_SIZE)) < ARTNET_OPCODE + 2 ||
+		memcmp(header, "Art-Net", 8) != 0 )
+	{
+		return;
+	}
+
+	opcode = header[ARTNET_OPCODE] | (header[ARTNET_OPCODE+1] << 8);
+	if( opcode == ARTNET_OP_SYNC )
+	{
+		if( drawn )
+		{
+			showFrame();
+		}
+		return;
+	}
+	if( opcode != ARTNET_OP_DMX || length < ARTNET_HEADER_SIZE )
+	{
+		return;
+	}
+
+	universe = (header[ARTNET_UNIVERSE] | (header[ARTNET_UNIVERSE+1] << 8)) + 1;
+	if( accept(universe, header[ARTNET_SEQUENCE]) )
+	{
+		count = (header[ARTNET_LENGTH] << 8) | header[ARTNET_LENGTH+1];
+		draw(artnet, universe - MY_UDP_UNIVERSE, min(count, (uint16_t)(length - ARTNET_HEADER_SIZE)));
+	}
+}
+
+/**
+ * Handles a DDP packet
+ */
+void UdpWrapper::receiveDdp(uint16_t length)
+{
+	uint16_t size = DDP_HEADER_SIZE;
+	uint8_t sequence;
+	uint8_t d;
+
+	if( length < DDP_HEADER_SIZE || ddp.read(header, DDP_HEADER_SIZE) != DDP_HEADER_SIZE ||
+		(header[DDP_FLAGS] & DDP_VERSION_MASK) != DDP_VERSION_1 )
+	{
+		return;
+	}
+	if( header[DDP_FLAGS] & DDP_FLAG_TIMECODE )
+	{
+		size += DDP_TIMECODE_SIZE;
+		if( length < size || ddp.read(header + DDP_HEADER_SIZE, DDP_TIMECODE_SIZE) != DDP_TIMECODE_SIZE )
+		{
+			return;
+		}
+	}
+
+	// Only pixel data for the display; queries are not answered
+	if( (header[DDP_FLAGS] & DDP_FLAG_QUERY) ||
+		(header[DDP_DESTINATION] != DDP_ID_DISPLAY && header[DDP_DESTINATION] != DDP_ID_ALL) )
+	{
+		return;
+	}
+
+	touch();
+
+	// Sequences run 1-15; more than halfway back is late, not wrapped
+	sequence = header[DDP_SEQUENCE] & 0x0F;
+	if( sequence != 0 && ddpSequence != 0 )
+	{
+		d = (sequence + 15 - ddpSequence) % 15;
+		if( d == 0 || d > 7 )
+		{
+			stale += 1;
+			return;
+		}
+	}
+	ddpSequence = sequence;
+
+	read(ddp, ((uint32_t)header[DDP_OFFSET] << 24) | ((uint32_t)header[DDP_OFFSET+1] << 16) |
+			((uint32_t)header[DDP_OFFSET+2] << 8) | header[DDP_OFFSET+3],
+			min( (uint16_t)((header[DDP_LENGTH] << 8) | header[DDP_LENGTH+1]), (uint16_t)(length - size) ));
+
+	// A push may come alone, to latch what earlier packets sent
+	if( (header[DDP_FLAGS] & DDP_FLAG_PUSH) && drawn )
+	{
+		showFrame();
+	}
+}
+
+/**
+ * Counts a packet and starts the stream if it is the first one
+ */
+void UdpWrapper::touch()
+{
+	if( !active )
+	{
+		Serial.println(F("UDP stream started"));
+		active = true;
+		firstPacket = millis();
+		packets = 0;
+		frames = 0;
+		stale = 0;
+		latency = 0;
+		maxLatency = 0;
+		received = 0;
+		sequenced = 0;
+		ddpSequence = 0;
+	}
+	lastPacket = millis();
+	packets += 1;
+}
+
+/**
+ * Returns true if the universe is one of ours and the packet is not older
+ * than the last one of the universe.  A sequence of 0 is not checked.
+ *
+ */
+uint8_t UdpWrapper::accept(uint16_t universe, uint8_t sequence)
+{
+	uint16_t index = universe - MY_UDP_UNIVERSE;
+	uint16_t bit;
+	int8_t d;
+
+	if( universe < MY_UDP_UNIVERSE || index >= universes )
+	{
+		return false;
+	}
+	bit = 1 << index;
+
+	touch();
+
+	// Late by up to 20 is out of order; further back the sender restarted
+	d = (int8_t)(sequence - sequences[index]);
+	if( sequence != 0 && (sequenced & bit) && d <= 0 && d > -20 )
+	{
+		stale += 1;
+		return false;
+	}
+	sequences[index] = sequence;
+	sequenced |= bit;
+
+	// A universe seen again starts the next frame; show what there is
+	if( received & bit )
+	{
+		showFrame();
+	}
+	received |= bit;
+
+	return true;
+}
+
+/**
+ * Reads count channels of universe index from the socket into the LEDs
+ *
+ */
+void UdpWrapper::draw(WiFiUDP& udp, uint8_t index, uint16_t count)
+{
+	read(udp, (uint32_t)index * UDP_UNIVERSE_PIXELS * sizeof(CRGB),
+			min( count, (uint16_t)(UDP_UNIVERSE_PIXELS * sizeof(CRGB)) ));
+
+	if( received == ((1 << universes) - 1) )
+	{
+		showFrame();
+	}
+}
+
+/**
+ * Reads count bytes of pixels from the socket into the LEDs, offset bytes
+ * from the first; bytes past the end are dropped
+ *
+ */
+void UdpWrapper::read(WiFiUDP& udp, uint32_t offset, uint16_t count)
+{
+	uint32_t end = (uint32_t)controller->size() * sizeof(CRGB);
+	CRGB* base = controller->getLayer(LAYER_BASE);
+
+	if( offset >= end || count == 0 )
+	{
+		return;
+	}
+	if( offset + count > end )
+	{
+		count = end - offset;
+	}
+
+	if( !drawn )
+	{
+		drawn = true;
+		frameStart = micros();
+	}
+
+	if( base != 0 )
+	{
+		udp.read( (uint8_t *)base + offset, count );
+		controller->markDirty(LAYER_BASE);
+	}
+	else
+	{
+		// Palette indexes; convert a few whole pixels at a time, only
+		// when the data starts on a pixel
+		uint8_t rgb[3*16];
+		uint16_t k;
+		count -= (offset % 3) ? count : count % 3;
+		for(uint16_t i=0; i<count; i+=k)
+		{
+			k = min( (uint16_t)(count - i), (uint16_t)sizeof(rgb) );
+			udp.read(rgb, k);
+			controller->setPixels((offset + i) / 3, rgb, k / 3, false);
+		}
+	}
+}
+
+/**
+ * Shows the frame received so far
+ */
+void UdpWrapper::showFrame()
+{
+	uint32_t t;
+
+	controller->show();
+	received = 0;
+	drawn = false;
+	frames += 1;
+
+	// Time from the first universe of the frame to the LEDs
+	t = micros() - frameStart;
+	latency += t;
+	if( t > maxLatency )
+	{
+		maxLatency = t;
+	}
+}
+
+/**
+ * Ends the stream; clears the held frame if asked
+ */
+void UdpWrapper::end(uint8_t clear)
+{
+	active = false;
+	dump();
+	if( clear )
+	{
+		controller->fill(BLACK, true);
+	}
+}
+
+/**
+ * Prints the throughput and latency of the last stream
+ */
+void UdpWrapper::dump()
+{
+	uint32_t elapsed = lastPacket - firstPacket;
+
+	Serial.print(F("UDP - packets: "));
+	Serial.print( packets );
+	Serial.print(F(", stale: "));
+	Serial.print( stale );
+	Serial.print(F(", frames: "));
+	Serial.print( frames );
+	Serial.print(F(", fps: "));
+	Serial.print( (elapsed > 0 && frames > 1) ? (frames - 1) * 1000 / elapsed : 0 );
+	Serial.print(F(", latency avg: "));
+	Serial.print( (frames > 0) ? latency / frames : 0 );
+	Serial.print(F(" us, max: "));
+	Serial.print( maxLatency );
+	Serial.println(F(" us"));
+}
@@ -0,0 +1,133 @@
+/*
+ * UdpWrapper.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#ifndef UDPWRAPPER_H_
+#define UDPWRAPPER_H_
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+#include "ClientGlobal.h"
+#include "NeopixelWrapper.h"
+
+#define UDP_E131_PORT			5568
+#define UDP_ARTNET_PORT			6454
+#define UDP_DDP_PORT			4048
+
+#define UDP_UNIVERSE_PIXELS		170		// 510 of the 512 DMX channels
+#define UDP_MAX_UNIVERSES		16
+#define UDP_MAX_PACKETS			8		// read per socket per work()
+
+// A sender silent this long is gone (ms); E1.31 network data loss time
+#define UDP_STREAM_TIMEOUT		2500
+
+// E1.31 data packet: root layer, framing layer, DMP layer, then the DMX
+// start code and channels.  Multi-byte values big endian.
+#define E131_HEADER_SIZE		126
+#define E131_ROOT_VECTOR		18		// 4, 0x00000004
+#define E131_FRAME_VECTOR		40		// 4, 0x00000002
+#define E131_SEQUENCE			111
+#define E131_OPTIONS			112
+#define E131_UNIVERSE			113		// 2
+#define E131_DMP_VECTOR			117		// 1, 0x02
+#define E131_COUNT				123		// 2, start code + channels
+#define E131_START_CODE			125
+#define E131_OPTION_PREVIEW		0x80
+#define E131_OPTION_TERMINATED	0x40
+
+// Art-Net: id, opcode (little endian) and the rest big endian
+#define ARTNET_HEADER_SIZE		18
+#define ARTNET_OPCODE			8		// 2
+#define ARTNET_SEQUENCE			12		// 0 = not sequenced
+#define ARTNET_UNIVERSE			14		// 2, sub-uni then net
+#define ARTNET_LENGTH			16		// 2
+#define ARTNET_OP_DMX			0x5000
+#define ARTNET_OP_SYNC			0x5200
+
+// DDP: flags, sequence, data type, destination, then offset and length
+// in bytes, big endian; a timecode follows when flagged
+#define DDP_HEADER_SIZE			10
+#define DDP_TIMECODE_SIZE		4
+#define DDP_FLAGS				0
+#define DDP_SEQUENCE			1		// low 4 bits, 1-15; 0 = not sequenced
+#define DDP_TYPE				2
+#define DDP_DESTINATION			3
+#define DDP_OFFSET				4		// 4
+#define DDP_LENGTH				8		// 2
+#define DDP_VERSION_MASK		0xC0
+#define DDP_VERSION_1			0x40
+#define DDP_FLAG_TIMECODE		0x10
+#define DDP_FLAG_QUERY			0x02
+#define DDP_FLAG_PUSH			0x01
+#define DDP_ID_DISPLAY			1
+#define DDP_ID_ALL				255
+
+/**
+ * Takes pixels from lighting desks and media servers over UDP, beside
+ * MQTT, for live shows where a broker and JSON add too much latency.
+ *
+ * E1.31 (sACN, unicast), Art-Net and DDP data is read from the socket
+ * straight into the base layer, without a copy in between.  The node
+ * takes as many universes from MY_UDP_UNIVERSE up as its LEDs need, 170
+ * pixels each; Art-Net universe 0 is E1.31 universe 1.  DDP addresses the
+ * LEDs by byte offset instead, so a long strip is one stream.  Packets
+ * that are older than the last one of their universe or stream are
+ * dropped.
+ *
+ * A frame is shown once every universe arrived, when a universe arrives
+ * again before that, on an Art-Net sync or on a DDP push.  A controller
+ * sends the data of every node first and then one push to all of them,
+ * so the nodes latch the frame together.  When the sender stops, the
+ * last frame is held for MY_UDP_HOLD_TIME and then cleared.  A desk
+ * cannot send MQTT commands, so as with streamed frames a running
+ * animation is stopped while the stream is active.
+ */
+class UdpWrapper
+{
+public:
+	UdpWrapper();
+	uint8_t initialize(NeopixelWrapper* controller);
+
+	void work();
+	uint8_t isActive();
+	void dump();
+
+protected:
+	WiFiUDP e131;
+	WiFiUDP artnet;
+	WiFiUDP ddp;
+	NeopixelWrapper* controller;
+	uint8_t header[E131_HEADER_SIZE];
+	uint8_t universes;
+	uint16_t received;
+	uint16_t sequenced;
+	uint8_t sequences[UDP_MAX_UNIVERSES];
+	uint8_t ddpSequence;
+	uint8_t drawn;
+
+	uint8_t active;
+	uint32_t firstPacket;
+	uint32_t lastPacket;
+	uint32_t frameStart;
+	uint32_t packets;
+	uint32_t frames;
+	uint32_t stale;
+	uint32_t latency;
+	uint32_t maxLatency;
+
+	void receiveE131(uint16_t length);
+	void receiveArtNet(uint16_t length);
+	void receiveDdp(uint16_t length);
+	void touch();
+	uint8_t accept(uint16_t universe, uint8_t sequence);
+	void draw(WiFiUDP& udp, uint8_t index, uint16_t count);
+	void read(WiFiUDP& udp, uint32_t offset, uint16_t count);
+	void showFrame();
+	void end(uint8_t clear);
+};
+
+#endif /* UDPWRAPPER_H_ */
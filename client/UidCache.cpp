@@ -0,0 +1,72 @@
+/*
+ * UidCache.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#include "UidCache.h"
+
+/**
+ * Constructor
+ */
+UidCache::UidCache()
+{
+	for(uint8_t i=0; i<UID_CACHE_SIZE; i++)
+	{
+		entries[i].uid = 0;
+		entries[i].time = 0;
+	}
+	duplicates = 0;
+}
+
+/**
+ * Returns true, and counts it, if the uid was seen within the window
+ */
+uint8_t UidCache::isDuplicate(uint32_t uid, uint32_t now)
+{
+	UidEntry* e = &entries[ slot(uid) ];
+
+	if( uid == 0 || e->uid != uid || (now - e->time) >= UID_WINDOW )
+	{
+		return false;
+	}
+
+	duplicates += 1;
+	return true;
+}
+
+/**
+ * Records the uid of a command that was accepted
+ */
+void UidCache::add(uint32_t uid, uint32_t now)
+{
+	UidEntry* e = &entries[ slot(uid) ];
+
+	if( uid != 0 )
+	{
+		e->uid = uid;
+		e->time = now;
+	}
+}
+
+/**
+ * Returns the number of copies dropped
+ */
+uint32_t UidCache::getDuplicates()
+{
+	return duplicates;
+}
+
+/**
+ * Returns the slot of a uid; controllers often count uids up, so the bits
+ * are mixed before masking
+ */
+uint8_t UidCache::slot(uint32_t uid)
+{
+	uid ^= uid >> 16;
+	uid *= 0x45d9f3bUL;
+	uid ^= uid >> 16;
+
+	return uid & (UID_CACHE_SIZE - 1);
+}
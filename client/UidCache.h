@@ -0,0 +1,53 @@
+/*
+ * UidCache.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: tsasala
+ */
+
+#ifndef UIDCACHE_H_
+#define UIDCACHE_H_
+
+#include <Arduino.h>
+
+#include "ClientGlobal.h"
+
+// Slots in the cache; a power of two
+#define UID_CACHE_SIZE		32
+
+// How long a uid counts as seen (ms)
+#define UID_WINDOW			60000
+
+typedef struct
+{
+	uint32_t uid;
+	uint32_t time;
+} UidEntry;
+
+/**
+ * Remembers the unique ids of recent commands so copies of a command can
+ * be dropped: the same command arrives on the all and node channels, from
+ * relay loops and from broker redelivery.
+ *
+ * Direct mapped: each uid has one slot, so a lookup is O(1) and a newer
+ * uid simply takes the slot over.  A copy can be missed when its slot was
+ * reused, but a new command is never taken for a copy.  A uid of 0 means
+ * the command has none and is never a copy.
+ */
+class UidCache
+{
+public:
+	UidCache();
+
+	uint8_t isDuplicate(uint32_t uid, uint32_t now);
+	void add(uint32_t uid, uint32_t now);
+	uint32_t getDuplicates();
+
+protected:
+	UidEntry entries[UID_CACHE_SIZE];
+	uint32_t duplicates;
+
+	uint8_t slot(uint32_t uid);
+};
+
+#endif /* UIDCACHE_H_ */
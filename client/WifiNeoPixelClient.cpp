@@ -8,10 +8,14 @@
 // Internal Variables
 static Configuration config;
 static NeopixelWrapper controller;
+static AnimationEngine engine;
 static PubSubWrapper pubsubw;
 static WifiWrapper wifiw;
 static Menu menu;
 static StatusIndicator statusIndicator;
+static FrameStream stream;
+static UdpWrapper udpw;
+static Metrics metrics;
 
 // software timer instance
 os_timer_t ledTimer;
@@ -19,12 +23,12 @@ volatile StatusEnum gStatus;
 volatile uint8_t gLedCounter;
 //volatile uint8_t gLedState;
 
-// Indicates we have a command waiting for processing
-static volatile uint8_t commandAvailable = false;
-
 // Internal functions
 void configure();
+void runCommands();
 void parseCommand();
+void completeCommand(Command* cmd);
+void publishMetrics(uint32_t now);
 boolean initialize();
 void ledTimerCallback(void *pArg);
 void startupPause();
@@ -130,12 +134,37 @@ void loop()
 	// calls yield and other must run code
 	worker();
 
-	// Check if command is available
-	if( isCommandAvailable() )
+	// A stream owns the LEDs; an animation would draw over its frames
+	if( engine.isRunning() && (udpw.isActive() || stream.isActive()) )
 	{
-		parseCommand();
+		engine.stop();
+		Serial.print( millis() );
+		Serial.println(F(" - Animation stopped by stream"));
+		engine.dump();
+		completeCommand( engine.getCommand() );
+	}
+
+	// Run queued commands
+	runCommands();
+
+	// Report how the node keeps up
+	if( metrics.isDue( millis() ) && pubsubw.connected() )
+	{
+		publishMetrics( millis() );
 	}
 
+	// Render the next animation frame if it is due
+	if( engine.run( millis() ) )
+	{
+		engine.dump();
+		pubsubw.getQueue()->dump();
+		pubsubw.getClock()->dump();
+		completeCommand( engine.getCommand() );
+	}
+	else if( !engine.isDue() )
+	{
+		engine.idle(); // wait for next frame; worker runs again on next pass
+	}
 
 	// Check if user wants to configure node
 	if( Serial.available() )
@@ -205,6 +234,17 @@ boolean initialize()
 			if ( controller.initialize(config.getNumberLeds(), DEFAULT_INTENSITY) )
 			{
 				statusIndicator.setStatus(Driver, Ok);
+				controller.setPowerBudget( config.getPowerBudget() );
+				engine.initialize(&controller);
+				engine.setMetrics(&metrics);
+				pubsubw.setMetrics(&metrics);
+				pubsubw.setProgram( engine.getProgram() );
+				stream.setController(&controller);
+				pubsubw.setStream(&stream);
+				if( !udpw.initialize(&controller) )
+				{
+					Serial.println(F("ERROR - realtime UDP not available"));
+				}
 
 				yield(); // give time to ESP
 				Serial.print(F("\nLED Controller initialized..."));
@@ -252,12 +292,13 @@ boolean initialize()
 void worker()
 {
 	pubsubw.work(); // process queue
+	udpw.work(); // realtime pixels
 	wifiw.work(); // check for OTA
 	yield(); // give time to ESP
 	ESP.wdtFeed(); // pump watch dog
 
 
-	// check if we are connected to mqtt server
+	// check if we are connected to mqtt server; pubsubw reconnects
 	if( pubsubw.connected() )
 	{
 		statusIndicator.setStatus(Queue, Ok);
@@ -265,7 +306,6 @@ void worker()
 	else
 	{
 		statusIndicator.setStatus(Queue, Error);
-		pubsubw.connect();
 	}
 
 	if( wifiw.connected() )
@@ -281,15 +321,55 @@ void worker()
 
 
 /**
- * Parses command buffer
+ * Runs the next queued command, or the commands of a batch back to back.
+ * A queued animation waits for the running one to finish unless it
+ * preempts it.  Once the first command of a batch ran, the rest follow
+ * whatever the engine is doing, and an atomic batch holds the LEDs until
+ * its last command ran, so it reaches them as one frame.
+ *
+ */
+void runCommands()
+{
+	static uint8_t inBatch = false;
+	CommandQueue* queue = pubsubw.getQueue();
+	Command* next = queue->peek();
+
+	while( next != 0 && (inBatch || !engine.isRunning() || next->getPreempt() || !engine.isAnimation(next->getCommand())) )
+	{
+		if( next->getAtomic() )
+		{
+			controller.holdShow();
+		}
+		inBatch = (next->getBatch() == BATCH_MEMBER);
+		parseCommand();
+		if( !inBatch )
+		{
+			break;
+		}
+		next = queue->peek();
+	}
+
+	if( !inBatch )
+	{
+		controller.releaseShow();
+	}
+}
+
+/**
+ * Runs the next queued command
+ *
+ * Static commands are executed immediately; animations are handed to the
+ * animation engine and complete from loop().  A command only interrupts
+ * the running animation if it is flagged to preempt it.
  *
  */
 void parseCommand()
 {
 	Command cmd;
 
-	// Reset command available flag
-	setCommandAvailable(false);
+	// Parsed by the MQTT callback; copied out so new messages can queue
+	pubsubw.getQueue()->pop(&cmd);
+	metrics.recordQueueWait( millis() - cmd.getReceiveTime() );
 	setStatus(Processing);
 
 #ifdef __DEBUG
@@ -297,227 +377,270 @@ void parseCommand()
 	Serial.print(F(" - parsing command..."));
 #endif
 
-	if( cmd.parse( (uint8_t *)pubsubw.getBuffer() ) )
+	if( cmd.getNodeId() == 0 )
 	{
-		if( cmd.getNodeId() == 0 )
-		{
-			cmd.setNodeId( config.getNodeId() );
-		}
+		cmd.setNodeId( config.getNodeId() );
+	}
 #ifdef __DEBUG
-		cmd.dump();
+	cmd.dump();
 #endif
-		switch(cmd.getCommand())
-		{
-		case CMD_SHOW:
-			Serial.println(F("SHOW"));
-			controller.show();
-			break;
-		case CMD_SET_PIXEL:
-			Serial.println(F("SET_PIXEL"));
-			controller.setPixel(cmd.getIndex(), cmd.getOnColor(), cmd.getShow() );
-			break;
-		case CMD_FILL:
-			Serial.println(F("FILL"));
-			controller.fill(cmd.getOnColor(), true);
-			break;
-		case CMD_FILL_PATTERN:
-			Serial.println(F("FILL_PATTERN"));
-			controller.fillPattern(cmd.getPattern(), cmd.getOnColor(), cmd.getOffColor());
-			break;
-		case CMD_PATTERN:
-			Serial.println(F("PATTERN"));
-			controller.rotatePattern(cmd.getRepeat(),cmd.getDuration(), cmd.getPattern(), cmd.getDirection(), cmd.getOnColor(), cmd.getOffColor(), cmd.getOnTime(), cmd.getOffTime());
-			break;
-		case CMD_WIPE:
-			Serial.println(F("WIPE"));
-			controller.wipe(cmd.getRepeat(),cmd.getDuration(), cmd.getDirection(), cmd.getOnColor(), cmd.getOffColor(), cmd.getOnTime(), cmd.getOffTime(), cmd.getClearAfter(), cmd.getClearEnd());
-			break;
-		case CMD_SCROLL:
-			Serial.println(F("SCROLL"));
-			controller.scrollPattern(cmd.getRepeat(),cmd.getDuration(), cmd.getPattern(), cmd.getPatternLength(), cmd.getDirection(), cmd.getOnColor(), cmd.getOffColor(), cmd.getOnTime(), cmd.getOffTime(), cmd.getClearAfter(), cmd.getClearEnd());
-			break;
-		case CMD_BOUNCE:
-			Serial.println(F("BOUNCE"));
-			controller.bounce(cmd.getRepeat(), cmd.getDuration(), cmd.getPattern(), cmd.getPatternLength(), cmd.getDirection(), cmd.getOnColor(), cmd.getOffColor(), cmd.getOnTime(), cmd.getOffTime(), cmd.getBounceTime(), cmd.getClearAfter(), cmd.getClearEnd());
-			break;
-		case CMD_MIDDLE:
-			controller.middle(cmd.getRepeat(),cmd.getDuration(), cmd.getDirection(), cmd.getOnColor(), cmd.getOffColor(), cmd.getOnTime(), cmd.getOffTime(), cmd.getClearAfter(), cmd.getClearEnd());
-			Serial.println(F("MIDDLE"));
-			break;
-		case CMD_RANDOM_FLASH:
-			Serial.println(F("RANDOM_FLASH"));
-			controller.randomFlash(cmd.getRepeat(),cmd.getDuration(), cmd.getOnTime(), cmd.getOffTime(), cmd.getOnColor(), cmd.getOffColor(), cmd.getNumber() );
-			break;
-		case CMD_FADE:
-			Serial.println(F("FADE"));
-			controller.fade(cmd.getDirection(), cmd.getFadeIncrement(), cmd.getFadeTime(), cmd.getOnColor());
-			break;
-		case CMD_STROBE:
-			Serial.println(F("STROBE"));
-			controller.strobe(cmd.getRepeat(),cmd.getDuration(), cmd.getOnColor(), cmd.getOffColor(), cmd.getOnTime(), cmd.getOffTime());
-			break;
-		case CMD_LIGHTNING:
-			Serial.println(F("LIGHTNING"));
-			controller.lightning(cmd.getRepeat(),cmd.getDuration(), cmd.getOnColor(), cmd.getOffColor());
-			break;
-		case CMD_STACK:
-			Serial.println(F("STACK"));
-			controller.stack(cmd.getRepeat(), cmd.getDuration(), cmd.getDirection(), cmd.getOnColor(), cmd.getOffColor(), cmd.getOnTime(), cmd.getClearEnd() );
-			break;
-		case CMD_FILL_RANDOM:
-			Serial.println(F("RANDOM FILL"));
-			controller.fillRandom(cmd.getRepeat(), cmd.getDuration(), cmd.getOnColor(), cmd.getOffColor(), cmd.getOnTime(), cmd.getOffTime(), cmd.getClearAfter(), cmd.getClearEnd());
-			break;
-		case CMD_RAINBOW:
-			Serial.println(F("RAINBOW"));
-			controller.rainbow(cmd.getDuration(), cmd.getProbability(), cmd.getOnColor(), cmd.getOnTime(), cmd.getHueUpdateTime());
-			break;
-		case CMD_RAINBOW_FADE:
-			Serial.println(F("RAINBOW_FADE"));
-			controller.rainbowFade(cmd.getDuration(), cmd.getOnTime());
-			break;
-		case CMD_CONFETTI:
-			Serial.println(F("CONFETTI"));
-			controller.confetti(cmd.getDuration(), cmd.getOnColor(), cmd.getFadeBy(), cmd.getOnTime(), cmd.getHueUpdateTime() );
-			break;
-		case CMD_CYLON:
-			Serial.println(F("CYLON"));
-			controller.cylon(cmd.getRepeat(), cmd.getDuration(), cmd.getOnColor(), cmd.getFadeTime(), cmd.getFramesPerSecond(), cmd.getHueUpdateTime());
-			break;
-		case CMD_BPM:
-			Serial.println(F("BPM"));
-			controller.bpm(cmd.getDuration(), cmd.getOnTime(), cmd.getHueUpdateTime() );
-			break;
-		case CMD_JUGGLE:
-			Serial.println(F("JUGGLE"));
-			controller.juggle(cmd.getDuration(), cmd.getOnTime());
-			break;
-		case CMD_SET_INTENSITY:
-			Serial.println(F("SET_INTENSITY"));
-			controller.setIntensity( cmd.getIntensity() );
-			break;
-		case CMD_COMPLETE:
-			Serial.println(F("COMPLETE"));
-			break;
-		case CMD_ERROR:
-		default:
-			Serial.println(F("ERROR - UNKNOWN COMMAND"));
-			break;
-		} // end switch
 
-		// Send response with the command is complete
-		if( cmd.getNotifyOnComplete() )
-		{
-			if( cmd.buildResponse( pubsubw.getBuffer() ) )
-			{
-				Serial.print(F("Publishing Completion Response: "));
-				Serial.println((char *)config.getMyResponseChannel() );
+	// Overlays are enabled by the first command drawing into them
+	if( cmd.getLayer() != LAYER_BASE && cmd.getCommand() != CMD_CLEAR_LAYER )
+	{
+		controller.enableLayer(cmd.getLayer(), cmd.getBlend(), cmd.getAlpha());
+	}
 
-				// Publish message to response channel
-				pubsubw.publish( (char *)config.getMyResponseChannel() );
-			}
+	// Stop the running animation if the command preempts it; it
+	// completes as interrupted.  Other static commands run between its
+	// frames; clearing a layer always stops it since the animation may
+	// own that layer.  An animation that gets here without preempting,
+	// as a later member of a batch, replaces the running one the same way
+	// so the latter still completes.
+	if( engine.isRunning() && (cmd.getPreempt() || cmd.getCommand() == CMD_CLEAR_LAYER ||
+		engine.isAnimation(cmd.getCommand())) )
+	{
+		engine.stop();
+		Serial.print( millis() );
+		Serial.println(F(" - Animation preempted"));
+		engine.dump();
+		completeCommand( engine.getCommand() );
+		setStatus(Processing);
+	}
 
-		} // end if notify on complete
+	// Crossfade from what is on the LEDs to whatever the command draws
+	if( cmd.getTransitionTime() > 0 )
+	{
+		controller.startTransition( cmd.getTransitionTime() );
+	}
 
-		// NOTE: Don't be foolish and send a command to "all" with relay set; strange things will happen
-		if( cmd.getRelay() == true )
+	controller.selectLayer( cmd.getLayer() );
+	switch(cmd.getCommand())
+	{
+	case CMD_SHOW:
+		Serial.println(F("SHOW"));
+		controller.show();
+		break;
+	case CMD_CLEAR_LAYER:
+		Serial.println(F("CLEAR_LAYER"));
+		controller.disableLayer( cmd.getLayer() );
+		controller.show();
+		break;
+	case CMD_SET_PIXEL:
+		Serial.println(F("SET_PIXEL"));
+		controller.setPixel(cmd.getIndex(), cmd.getOnColor(), cmd.getShow() );
+		break;
+	case CMD_FILL:
+		Serial.println(F("FILL"));
+		controller.fill(cmd.getOnColor(), true);
+		break;
+	case CMD_FILL_PATTERN:
+		Serial.println(F("FILL_PATTERN"));
+		controller.fillPattern(cmd.getPattern(), cmd.getOnColor(), cmd.getOffColor());
+		break;
+	case CMD_PATTERN:
+		Serial.println(F("PATTERN"));
+		engine.start(&cmd);
+		break;
+	case CMD_WIPE:
+		Serial.println(F("WIPE"));
+		engine.start(&cmd);
+		break;
+	case CMD_SCROLL:
+		Serial.println(F("SCROLL"));
+		engine.start(&cmd);
+		break;
+	case CMD_BOUNCE:
+		Serial.println(F("BOUNCE"));
+		engine.start(&cmd);
+		break;
+	case CMD_MIDDLE:
+		Serial.println(F("MIDDLE"));
+		engine.start(&cmd);
+		break;
+	case CMD_RANDOM_FLASH:
+		Serial.println(F("RANDOM_FLASH"));
+		engine.start(&cmd);
+		break;
+	case CMD_FADE:
+		Serial.println(F("FADE"));
+		engine.start(&cmd);
+		break;
+	case CMD_STROBE:
+		Serial.println(F("STROBE"));
+		engine.start(&cmd);
+		break;
+	case CMD_LIGHTNING:
+		Serial.println(F("LIGHTNING"));
+		engine.start(&cmd);
+		break;
+	case CMD_STACK:
+		Serial.println(F("STACK"));
+		engine.start(&cmd);
+		break;
+	case CMD_FILL_RANDOM:
+		Serial.println(F("RANDOM FILL"));
+		engine.start(&cmd);
+		break;
+	case CMD_RAINBOW:
+		Serial.println(F("RAINBOW"));
+		engine.start(&cmd);
+		break;
+	case CMD_RAINBOW_FADE:
+		Serial.println(F("RAINBOW_FADE"));
+		engine.start(&cmd);
+		break;
+	case CMD_CONFETTI:
+		Serial.println(F("CONFETTI"));
+		engine.start(&cmd);
+		break;
+	case CMD_CYLON:
+		Serial.println(F("CYLON"));
+		engine.start(&cmd);
+		break;
+	case CMD_BPM:
+		Serial.println(F("BPM"));
+		engine.start(&cmd);
+		break;
+	case CMD_JUGGLE:
+		Serial.println(F("JUGGLE"));
+		engine.start(&cmd);
+		break;
+	case CMD_RUN_PROGRAM:
+		Serial.println(F("RUN_PROGRAM"));
+		engine.start(&cmd);
+		break;
+	case CMD_LOAD_PROGRAM:
+		Serial.println(F("LOAD_PROGRAM")); // loaded on arrival
+		break;
+	case CMD_STORE_PRESET:
+		Serial.println(F("STORE_PRESET")); // stored on arrival
+		break;
+	case CMD_SET_METRICS:
+		Serial.println(F("SET_METRICS"));
+		metrics.setInterval( cmd.getDuration() );
+		break;
+	case CMD_SET_INTENSITY:
+		Serial.println(F("SET_INTENSITY"));
+		controller.setIntensity( cmd.getIntensity() );
+		break;
+	case CMD_COMPLETE:
+		Serial.println(F("COMPLETE"));
+		break;
+	case CMD_ERROR:
+	default:
+		Serial.println(F("ERROR - UNKNOWN COMMAND"));
+		break;
+	} // end switch
+	controller.selectLayer( LAYER_BASE );
+
+	// Animations complete later from loop()
+	if( !engine.isRunning() || !engine.isAnimation(cmd.getCommand()) )
+	{
+		completeCommand( &cmd );
+		if( engine.isRunning() )
 		{
-			Serial.print( millis() );
-			Serial.println(F(" - Relay Command"));
-			if(  cmd.getRelayNodeSize() > 0 )
-			{
-				uint8_t *relayNodes = cmd.getRelayNodes(); // get relay node array
-				uint8_t destNode = relayNodes[0]; // save the node we are relaying to
-
-				if( destNode > 0 )
-				{
-					cmd.setNodeId( destNode ); // change node ID for command
-
-					Serial.print( millis() );
-					Serial.print(F(" - Relaying to: "));
-					Serial.println( destNode );
-
-					// Shift relay nodes left 1, removing destination from list
-					// (we don't want to relay back to ourselves)
-					cmd.shiftRelayNodes();
-
-					// Build "new" command to relay to next node
-					if( cmd.buildCommand( pubsubw.getBuffer() ) )
-					{
-						// Build channel to send it to
-						char channel[STRING_SIZE];
-						memset(channel, 0, STRING_SIZE);
-						sprintf((char *)channel, DEFAULT_CHANNEL_MY, destNode );
-
-						// Send command
-						Serial.print( millis() );
-						Serial.print(F(" - Publishing Relay Command: "));
-						Serial.println(channel );
-
-						pubsubw.publish( channel );
-					}
-				}
-				else
-				{
-					Serial.println(F("ERROR - Destination Node = 0"));
-				}
-			}
-			else
-			{
-				Serial.println(F("** END OF RELAY CHAIN **"));
-			}
-
-		} // end if relay
-
-	} // end if cmd parse = true
-
-	Serial.print( millis() );
-	Serial.println(F(" - Command Complete"));
+			setStatus(Processing);
+		}
+	}
 
-	setStatus(Waiting);
 }
 
 /**
- * Returns flag; true=new command is available
+ * Publishes the metrics of the interval just ended on the response channel
+ *
  */
-boolean isCommandAvailable()
+void publishMetrics(uint32_t now)
 {
-	return commandAvailable;
+	metrics.setRequestedFps( engine.isRunning() ? engine.getCommand()->getFramesPerSecond() : 0 );
+	metrics.setReconnects( pubsubw.getReconnects(), wifiw.getDisconnects(), wifiw.getConnectTime() );
+	if( metrics.buildSnapshot( pubsubw.getBuffer(), config.getNodeId(), now ) )
+	{
+		pubsubw.publish( (char *)config.getMyResponseChannel() );
+	}
 }
 
 /**
- * Sets command available flag
+ * Finishes a command: sends the completion response and relays the
+ * command to the next node if requested.
  *
  */
-void setCommandAvailable(boolean flag)
+void completeCommand(Command* cmd)
 {
-	commandAvailable = flag;
-}
+	// Send response with the command is complete
+	if( cmd->getNotifyOnComplete() )
+	{
+		cmd->setPowerReport( controller.getPowerPeak(), controller.getPowerScale() );
+		cmd->setQueueReport( pubsubw.getQueue()->getDepth(), pubsubw.getQueue()->getDropped(),
+				pubsubw.getSeen()->getDuplicates() );
+		if( cmd->buildResponse( pubsubw.getBuffer() ) )
+		{
+			Serial.print(F("Publishing Completion Response: "));
+			Serial.println((char *)config.getMyResponseChannel() );
 
+			// Publish message to response channel
+			pubsubw.publish( (char *)config.getMyResponseChannel() );
+		}
 
-/**
- * Delay function with command check
- */
-uint8_t commandDelay(uint32_t time)
-{
-	boolean cmd = isCommandAvailable();
-	if( time == 0 ) return cmd;
+	} // end if notify on complete
 
-	if( !cmd )
+	// NOTE: Don't be foolish and send a command to "all" with relay set; strange things will happen
+	// Commands relayed on receipt were already forwarded by the callback
+	if( cmd->getRelay() == RELAY_ON_COMPLETE )
 	{
-		for (uint32_t i = 0; i < time; i++)
+		Serial.print( millis() );
+		Serial.println(F(" - Relay Command"));
+		if(  cmd->getRelayNodeSize() > 0 )
 		{
-			delay(1);
-			worker();
-			cmd = isCommandAvailable();
-			if (cmd)
+			uint8_t destNode;
+			uint8_t first;
+			uint8_t size;
+
+			// Each node we relay to gets its part of the relay list
+			for(uint8_t i=0; cmd->getRelayChild(i, &destNode, &first, &size); i++)
 			{
-				break;
+				if( destNode == 0 )
+				{
+					Serial.println(F("ERROR - Destination Node = 0"));
+					continue;
+				}
+
+				Command relayed = *cmd;
+				relayed.setNodeId( destNode ); // change node ID for command
+				relayed.setRelayNodes( cmd->getRelayNodes() + first, size );
+
+				Serial.print( millis() );
+				Serial.print(F(" - Relaying to: "));
+				Serial.println( destNode );
+
+				// Build "new" command to relay to next node
+				if( relayed.buildCommand( pubsubw.getBuffer() ) )
+				{
+					// Build channel to send it to
+					char channel[STRING_SIZE];
+					memset(channel, 0, STRING_SIZE);
+					sprintf((char *)channel, DEFAULT_CHANNEL_MY, destNode );
+
+					// Send command
+					Serial.print( millis() );
+					Serial.print(F(" - Publishing Relay Command: "));
+					Serial.println(channel );
+
+					pubsubw.publish( channel );
+				}
 			}
 		}
-	}
-	return cmd;
+		else
+		{
+			Serial.println(F("** END OF RELAY CHAIN **"));
+		}
 
+	} // end if relay
+
+	Serial.print( millis() );
+	Serial.println(F(" - Command Complete"));
+
+	setStatus(Waiting);
 }
 
 /**
@@ -14,11 +14,13 @@
 #include <user_interface.h>
 
 #include "ClientGlobal.h"
+#include "AnimationEngine.h"
 #include "Command.h"
 #include "Configuration.h"
 #include "Helper.h"
 #include "Menu.h"
 #include "StatusIndicator.h"
+#include "UdpWrapper.h"
 
 
 #define NUM_PIXELS 4
@@ -26,10 +28,6 @@
 
 void worker();
 
-boolean isCommandAvailable();
-void setCommandAvailable(boolean flag);
-uint8_t commandDelay(uint32_t time);
-
 void setStatus(volatile StatusEnum status);
 volatile StatusEnum getStatus();
 
@@ -10,6 +10,19 @@
 WifiWrapper::WifiWrapper()
 {
 	config = 0;
+	state = WIFI_STATE_IDLE;
+	gotIp = false;
+	lost = false;
+	fast = false;
+	cacheValid = false;
+	otaStarted = false;
+	attemptStart = 0;
+	nextAttempt = 0;
+	backoff = WIFI_BACKOFF_MIN;
+	connectTime = 0;
+	connects = 0;
+	disconnects = 0;
+	memset(&cache, 0, sizeof(cache));
 }
 
 
@@ -33,8 +46,7 @@ uint8_t WifiWrapper::initialize(Configuration* config)
 uint8_t WifiWrapper::initialize()
 {
 	uint8_t flag = false;
-	uint8_t count = 0;
-	char hostname[20];
+	uint32_t deadline;
 
 	Serial.println(F("Initializing WIFI..."));
 
@@ -44,6 +56,14 @@ uint8_t WifiWrapper::initialize()
 		return flag;
 	}
 
+	// We reconnect ourselves and keep the credentials out of flash
+	WiFi.persistent(false);
+	WiFi.mode(WIFI_STA);
+	WiFi.setAutoReconnect(false);
+	gotIpHandler = WiFi.onStationModeGotIP( [this](const WiFiEventStationModeGotIP& e) { gotIp = true; } );
+	disconnectedHandler = WiFi.onStationModeDisconnected( [this](const WiFiEventStationModeDisconnected& e) { lost = true; } );
+	loadCache();
+
 	Serial.print(F("Connection Status: "));
 	if( WiFi.status() == WL_CONNECTED )
 	{
@@ -89,75 +109,198 @@ uint8_t WifiWrapper::initialize()
 	// Connect to specified network
 	Serial.print(F("Connecting to "));
 	Serial.print((char *)config->getSsid() );
+	Serial.print( cacheValid ? F(" (cached)...") : F("...") );
+
+	// Wait as long as the old polling loop did; returns as soon as the
+	// node is on the network, and work() keeps trying if it is not
+	begin( millis() );
+	deadline = millis() + 250 + 500*(uint32_t)config->getWifiTries();
+	while( state != WIFI_STATE_CONNECTED && (int32_t)(millis() - deadline) < 0 )
+	{
+		Helper::delayYield(10); // Give time to ESP
+		work();
+	}
+
+	if( state == WIFI_STATE_CONNECTED )
+	{
+		Serial.print(F("SUCCESS!\n\rConnected: "));
+		Serial.print(WiFi.localIP());
+		Serial.print(F(" in "));
+		Serial.print(connectTime);
+		Serial.println(F(" ms"));
+		flag = true;
+	}
+	else
+	{
+		Serial.println(F("FAILED!"));
+	}
 
-	// We start by connecting to a WiFi network
-	WiFi.begin( (char *)config->getSsid(), (char *)config->getPassword());
+	return flag;
+
+}
+
+/**
+ * Starts an association attempt; with the cached access point and channel
+ * unless that already failed
+ *
+ */
+void WifiWrapper::begin(uint32_t now)
+{
+	gotIp = false;
+	lost = false;
+	attemptStart = now;
+	state = WIFI_STATE_CONNECTING;
+
+	fast = cacheValid;
+	if( fast )
+	{
+		WiFi.begin( (char *)config->getSsid(), (char *)config->getPassword(), cache.channel, cache.bssid, true );
+	}
+	else
+	{
+		WiFi.begin( (char *)config->getSsid(), (char *)config->getPassword() );
+	}
+}
 
-	Helper::delayYield(250); // Give time to ESP
-	//delay(250);
+/**
+ * Runs the connection state machine; the WiFi events only set flags, so
+ * everything happens here in loop context
+ *
+ */
+void WifiWrapper::work()
+{
+	uint32_t now = millis();
 
-	while( count < config->getWifiTries() )
+	switch( state )
 	{
-		if( WiFi.status() == WL_CONNECTED )
+	case WIFI_STATE_CONNECTING:
+		if( gotIp )
+		{
+			connectTime = now - attemptStart;
+			connects += 1;
+			backoff = WIFI_BACKOFF_MIN;
+			lost = false; // raised while associating
+			state = WIFI_STATE_CONNECTED;
+			saveCache();
+			if( !otaStarted )
+			{
+				startOta();
+			}
+		}
+		else if( fast && (lost || (now - attemptStart) >= WIFI_FAST_TIMEOUT) )
+		{
+			// The access point moved or changed channel; scan for it
+			Serial.println(F("Cached access point not found; scanning"));
+			cacheValid = false;
+			begin(now);
+		}
+		else if( (now - attemptStart) >= WIFI_CONNECT_TIMEOUT )
 		{
-			flag = true;
+			WiFi.disconnect();
+			nextAttempt = now + backoff;
+			backoff = min( backoff*2, (uint32_t)WIFI_BACKOFF_MAX );
+			state = WIFI_STATE_WAITING;
+		}
+		break;
+
+	case WIFI_STATE_CONNECTED:
+		if( lost )
+		{
+			Serial.println(F("WIFI connection lost"));
+			disconnects += 1;
+			begin(now);
 			break;
 		}
-		else
+		ArduinoOTA.handle();
+		break;
+
+	case WIFI_STATE_WAITING:
+		if( (int32_t)(now - nextAttempt) >= 0 )
 		{
-			count += 1;
-			Serial.print(F("."));
-			Helper::delayYield(500); // Delay and give time to ESP
+			begin(now);
 		}
+		break;
 	}
+}
 
-	if( flag )
-	{
-		Serial.print(F(".SUCCESS!\n\rConnected: "));
-		Serial.println(WiFi.localIP());
+/**
+ * Sets up over the air updates; once, on the first connection
+ *
+ */
+void WifiWrapper::startOta()
+{
+	char hostname[20];
 
-		// pause after configuring WIFI
-		Helper::delayYield(250); // Give time to ESP
+	Serial.println(F("Setting up OTA..."));
 
-		Serial.println(F("Setting up OTA..."));
+	sprintf(hostname, "lednode-%i", config->getNodeId() );
 
-		sprintf(hostname, "lednode-%i", config->getNodeId() );
+	ArduinoOTA.setHostname(hostname);
 
-		ArduinoOTA.setHostname(hostname);
+	ArduinoOTA.onStart([]() {
+		Serial.println("OTA Start");
+		setStatus(Uploading);
+	});
 
-		ArduinoOTA.onStart([]() {
-			Serial.println("OTA Start");
-			setStatus(Uploading);
-		});
+	ArduinoOTA.onEnd([]() {
+		Serial.println("OTA End");
+		Serial.println("Rebooting...");
+	});
 
-		ArduinoOTA.onEnd([]() {
-			Serial.println("OTA End");
-			Serial.println("Rebooting...");
-		});
+	ArduinoOTA.onProgress([](unsigned int progress, unsigned int total) {
+		Serial.printf("Progress: %u%%\r\n", (progress / (total / 100)));
+		// TODO - put LED flash here or call back
+	});
 
-		ArduinoOTA.onProgress([](unsigned int progress, unsigned int total) {
-			Serial.printf("Progress: %u%%\r\n", (progress / (total / 100)));
-			// TODO - put LED flash here or call back
-		});
+	ArduinoOTA.onError([](ota_error_t error) {
+		Serial.printf("Error[%u]: ", error);
+		if (error == OTA_AUTH_ERROR) Serial.println("Auth Failed");
+		else if (error == OTA_BEGIN_ERROR) Serial.println("Begin Failed");
+		else if (error == OTA_CONNECT_ERROR) Serial.println("Connect Failed");
+		else if (error == OTA_RECEIVE_ERROR) Serial.println("Receive Failed");
+		else if (error == OTA_END_ERROR) Serial.println("End Failed");
+	});
+	ArduinoOTA.begin();
+	otaStarted = true;
+}
 
-		ArduinoOTA.onError([](ota_error_t error) {
-			Serial.printf("Error[%u]: ", error);
-			if (error == OTA_AUTH_ERROR) Serial.println("Auth Failed");
-			else if (error == OTA_BEGIN_ERROR) Serial.println("Begin Failed");
-			else if (error == OTA_CONNECT_ERROR) Serial.println("Connect Failed");
-			else if (error == OTA_RECEIVE_ERROR) Serial.println("Receive Failed");
-			else if (error == OTA_END_ERROR) Serial.println("End Failed");
-		});
-		ArduinoOTA.begin();
+/**
+ * Reads the access point and channel of the last connection from RTC
+ * memory, which survives a reset but not a power cycle.  The cache only
+ * counts for the configured network.
+ *
+ */
+void WifiWrapper::loadCache()
+{
+	cacheValid = ESP.rtcUserMemoryRead(WIFI_RTC_OFFSET, (uint32_t *)&cache, sizeof(cache)) &&
+			cache.crc == cacheChecksum();
+}
 
-	}
-	else
-	{
-		Serial.print(F(".FAILED!"));
-	}
+/**
+ * Writes the access point and channel connected to into RTC memory
+ *
+ */
+void WifiWrapper::saveCache()
+{
+	memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+	cache.channel = WiFi.channel();
+	cache.crc = cacheChecksum();
+	cacheValid = ESP.rtcUserMemoryWrite(WIFI_RTC_OFFSET, (uint32_t *)&cache, sizeof(cache));
+}
 
-	return flag;
+/**
+ * Returns the checksum of the cache and the configured network name
+ *
+ */
+uint8_t WifiWrapper::cacheChecksum()
+{
+	uint8_t key[sizeof(cache.bssid) + 1 + STRING_SIZE];
+
+	memcpy(key, cache.bssid, sizeof(cache.bssid));
+	key[sizeof(cache.bssid)] = cache.channel;
+	memcpy(key + sizeof(cache.bssid) + 1, config->getSsid(), STRING_SIZE);
 
+	return Configuration::computeChecksum(key, sizeof(key)) ^ WIFI_RTC_MAGIC;
 }
 
 /**
@@ -171,17 +314,48 @@ WiFiClient& WifiWrapper::getWifiClient()
 
 uint8_t WifiWrapper::connected()
 {
-	if( WiFi.status() == WL_CONNECTED )
-	{
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return ( state == WIFI_STATE_CONNECTED );
 }
 
-void WifiWrapper::work()
+/**
+ * Returns the time the last connection took, from the start of the
+ * attempt to an IP address (ms)
+ *
+ */
+uint32_t WifiWrapper::getConnectTime()
+{
+	return connectTime;
+}
+
+/**
+ * Returns the number of connections made
+ */
+uint32_t WifiWrapper::getConnects()
+{
+	return connects;
+}
+
+/**
+ * Returns the number of connections lost
+ */
+uint32_t WifiWrapper::getDisconnects()
+{
+	return disconnects;
+}
+
+/**
+ * Prints the connection state and metrics
+ */
+void WifiWrapper::dump()
 {
-	  ArduinoOTA.handle();
+	Serial.print(F("WIFI - state: "));
+	Serial.print(state);
+	Serial.print(F(", connects: "));
+	Serial.print(connects);
+	Serial.print(F(", lost: "));
+	Serial.print(disconnects);
+	Serial.print(F(", last connect: "));
+	Serial.print(connectTime);
+	Serial.print(F(" ms, cached: "));
+	Serial.println(cacheValid);
 }
@@ -17,6 +17,47 @@
 #include "Configuration.h"
 #include "Helper.h"
 
+// Connection states
+#define WIFI_STATE_IDLE			0
+#define WIFI_STATE_CONNECTING	1
+#define WIFI_STATE_CONNECTED	2
+#define WIFI_STATE_WAITING		3	// for the next attempt
+
+// Longest wait for the cached access point before scanning (ms)
+#define WIFI_FAST_TIMEOUT		1500
+
+// Longest wait for an attempt with a scan (ms)
+#define WIFI_CONNECT_TIMEOUT	10000
+
+// Wait between failed attempts (ms); doubles on every failure
+#define WIFI_BACKOFF_MIN		1000
+#define WIFI_BACKOFF_MAX		30000
+
+// Where the access point cache sits in RTC user memory (4 byte blocks);
+// eboot keeps the OTA update command in blocks 0-31
+#define WIFI_RTC_OFFSET			32
+#define WIFI_RTC_MAGIC			0xA5
+
+/**
+ * Access point and channel of the last connection; kept in RTC memory
+ */
+typedef struct
+{
+	uint8_t bssid[6];
+	uint8_t channel;
+	uint8_t crc;
+} WifiCache;
+
+/**
+ * Keeps the node on the network.
+ *
+ * The WiFi events only raise flags; work() runs the connection from them
+ * without ever blocking the frame loop, and reconnects with a growing
+ * backoff when the network goes away.  The access point and channel of
+ * the last connection are kept in RTC memory, so after a reset the node
+ * associates without a scan; if the access point is not there, it falls
+ * back to a scan.
+ */
 class WifiWrapper
 {
 public:
@@ -29,10 +70,38 @@ public:
 	uint8_t connected();
 	void work();
 
+	uint32_t getConnectTime();
+	uint32_t getConnects();
+	uint32_t getDisconnects();
+	void dump();
+
 protected:
 	WiFiClient wifi;
 	Configuration* config;
+	WiFiEventHandler gotIpHandler;
+	WiFiEventHandler disconnectedHandler;
+
+	uint8_t state;
+	volatile uint8_t gotIp;
+	volatile uint8_t lost;
+	uint8_t fast;
+	uint8_t otaStarted;
+	uint32_t attemptStart;
+	uint32_t nextAttempt;
+	uint32_t backoff;
+
+	WifiCache cache;
+	uint8_t cacheValid;
+
+	uint32_t connectTime;
+	uint32_t connects;
+	uint32_t disconnects;
 
+	void begin(uint32_t now);
+	void startOta();
+	void loadCache();
+	void saveCache();
+	uint8_t cacheChecksum();
 };
 
 